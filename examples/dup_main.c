@@ -0,0 +1,79 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bf.h"
+#include "hash_file.h"
+
+#define RECORDS_NUM 200 // records with other ids around the repeated one
+#define REPEATS 100 // copies of the repeated id, far more than a bucket holds
+#define REPEATED_ID 7
+#define GLOBAL_DEPT 2 // you can change it if you want
+#define FILE_NAME "data.db"
+
+const char* cities[] = {
+  "Athens",
+  "San Francisco",
+  "Los Angeles",
+  "Amsterdam",
+  "London",
+  "New York",
+  "Tokyo",
+  "Hong Kong",
+  "Munich",
+  "Miami"
+};
+
+#define CALL_OR_DIE(call)     \
+  {                           \
+    HT_ErrorCode code = call; \
+    if (code != HT_OK) {      \
+      printf("Error\n");      \
+      exit(code);             \
+    }                         \
+  }
+
+// an extendible bucket full of one id can not be split apart, it gets overflow blocks
+// instead of doubling the directory until MAX_DEPTH
+int main() {
+  CALL_OR_DIE(HT_Init());
+
+  int indexDesc;
+  CALL_OR_DIE(HT_CreateIndex(FILE_NAME, GLOBAL_DEPT));
+  CALL_OR_DIE(HT_OpenIndex(FILE_NAME, &indexDesc));
+
+  Record record;
+  memset(&record, 0, sizeof(Record));
+  strcpy(record.name, "Dup");
+  strcpy(record.surname, "Licate");
+  printf("Insert Entries\n");
+  for (int i = 0; i < RECORDS_NUM + REPEATS; ++i) {
+    // every other insert is the repeated id until all its copies are in
+    record.id = i % 2 == 0 && i / 2 < REPEATS ? REPEATED_ID : REPEATED_ID + 1 + i;
+    strcpy(record.city, cities[i % 10]);
+    CALL_OR_DIE(HT_InsertEntry(indexDesc, record));
+  }
+
+  HT_Statistics stats;
+  CALL_OR_DIE(HT_GetStatistics(indexDesc, &stats));
+  printf("%d records in %d blocks, %d of them buckets\n", stats.records, stats.blocks, stats.buckets);
+
+  printf("RUN UpdateFields\n");
+  strcpy(record.city, "Patras");
+  CALL_OR_DIE(HT_UpdateFields(indexDesc, REPEATED_ID, FIELD_CITY, &record));
+  int id = REPEATED_ID;
+  CALL_OR_DIE(HT_PrintAllEntries(indexDesc, &id));
+
+  printf("RUN DeleteEntry\n");
+  CALL_OR_DIE(HT_DeleteEntry(indexDesc, REPEATED_ID));
+  CALL_OR_DIE(HT_GetStatistics(indexDesc, &stats));
+  printf("%d records in %d blocks, %d of them buckets\n", stats.records, stats.blocks, stats.buckets);
+  if (stats.records != RECORDS_NUM) {
+    printf("Error\n");
+    exit(1);
+  }
+
+  CALL_OR_DIE(HashStatistics(FILE_NAME));
+
+  CALL_OR_DIE(HT_CloseFile(indexDesc));
+  BF_Close();
+}
@@ -0,0 +1,327 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "bf.h"
+#include "hash_file.h"
+
+// Load a CSV (id,name,surname,city per line) or a packed binary file of Records into an index.
+// The input is memory-mapped and read in windows: the lines of a window are parsed on several
+// threads and grouped by the low bits of the id, so records of the same bucket are inserted one
+// after the other, while the previous window is being inserted.
+
+#define MAX_THREADS 64
+#define WINDOW_MB 64 // input read per batch, you can change it with -w
+#define GROUP_BITS 12 // records are grouped by the low GROUP_BITS bits of the id, the bits that pick the slot
+#define GROUPS (1 << GROUP_BITS)
+
+#define CALL_OR_DIE(call)     \
+  {                           \
+    HT_ErrorCode code = call; \
+    if (code != HT_OK) {      \
+      printf("Error\n");      \
+      exit(code);             \
+    }                         \
+  }
+
+typedef struct Part { // the lines of a window parsed by one thread
+  const char* begin;
+  const char* end;
+  bool binary;
+  Record* records;
+  int count;
+  int capacity;
+  long badRows;
+  int histogram[GROUPS];
+  int offset[GROUPS]; // where the records of every group go in the batch
+  Record* batch;
+} Part;
+
+typedef struct Window { // a batch of the input, parsed, grouped and ready to insert
+  Part parts[MAX_THREADS];
+  pthread_t threads[MAX_THREADS];
+  int threadCount;
+  Record* batch;
+  int count;
+  long badRows;
+} Window;
+
+static int groupOf(int id)
+{
+  return id & (GROUPS - 1);
+}
+
+// copy a field up to the next comma or the end of the line, cut to fit the record
+static const char* copyField(const char* p, const char* end, char* field, int size)
+{
+  int length = 0;
+  while (p < end && *p != ',' && *p != '\n' && *p != '\r') {
+    if (length < size - 1)
+      field[length++] = *p;
+    p++;
+  }
+  field[length] = '\0';
+  return p < end && *p == ',' ? p + 1 : p;
+}
+
+// parse one line into a record, false for a header or a malformed line
+static bool parseLine(const char* p, const char* end, Record* record)
+{
+  char* idEnd;
+  errno = 0;
+  long id = strtol(p, &idEnd, 10);
+  if (idEnd == p || idEnd >= end || *idEnd != ',' || errno != 0 || id != (int)id)
+    return false;
+  memset(record, 0, sizeof(Record));
+  record->id = (int)id;
+  p = copyField(idEnd + 1, end, record->name, sizeof(record->name));
+  p = copyField(p, end, record->surname, sizeof(record->surname));
+  copyField(p, end, record->city, sizeof(record->city));
+  return true;
+}
+
+static void* parsePart(void* arg)
+{
+  Part* part = arg;
+  part->count = 0;
+  part->badRows = 0;
+  memset(part->histogram, 0, sizeof(part->histogram));
+  if (part->binary) {
+    int count = (part->end - part->begin) / sizeof(Record);
+    if (count > part->capacity) {
+      part->capacity = count;
+      part->records = realloc(part->records, count * sizeof(Record));
+    }
+    memcpy(part->records, part->begin, count * sizeof(Record));
+    part->count = count;
+  } else {
+    for (const char* p = part->begin; p < part->end;) {
+      const char* line = p;
+      const char* lineEnd = memchr(p, '\n', part->end - p);
+      if (lineEnd == NULL)
+        lineEnd = part->end;
+      p = lineEnd + 1;
+      if (lineEnd == line || (lineEnd == line + 1 && *line == '\r'))
+        continue; // empty line
+      if (part->count == part->capacity) {
+        part->capacity = part->capacity == 0 ? 4096 : part->capacity * 2;
+        part->records = realloc(part->records, part->capacity * sizeof(Record));
+      }
+      if (parseLine(line, lineEnd, &part->records[part->count]))
+        part->count++;
+      else
+        part->badRows++;
+    }
+  }
+  for (int i = 0; i < part->count; i++)
+    part->histogram[groupOf(part->records[i].id)]++;
+  return NULL;
+}
+
+static void* scatterPart(void* arg)
+{
+  Part* part = arg;
+  for (int i = 0; i < part->count; i++)
+    part->batch[part->offset[groupOf(part->records[i].id)]++] = part->records[i];
+  return NULL;
+}
+
+// split [begin, end) on line boundaries (or whole records) and start a thread on every part
+static void startParse(Window* window, const char* begin, const char* end, bool binary)
+{
+  long length = end - begin;
+  const char* from = begin;
+  for (int t = 0; t < window->threadCount; t++) {
+    const char* to = t == window->threadCount - 1 ? end : begin + length * (t + 1) / window->threadCount;
+    if (to < from)
+      to = from;
+    if (binary)
+      to = from + (to - from) / sizeof(Record) * sizeof(Record);
+    else if (to < end) {
+      const char* newline = memchr(to, '\n', end - to);
+      to = newline == NULL ? end : newline + 1;
+    }
+    window->parts[t].begin = from;
+    window->parts[t].end = to;
+    window->parts[t].binary = binary;
+    pthread_create(&window->threads[t], NULL, parsePart, &window->parts[t]);
+    from = to;
+  }
+}
+
+// wait for the parsers, then put the records of every group together in the batch of the window
+static void finishParse(Window* window)
+{
+  window->count = 0;
+  window->badRows = 0;
+  for (int t = 0; t < window->threadCount; t++) {
+    pthread_join(window->threads[t], NULL);
+    window->count += window->parts[t].count;
+    window->badRows += window->parts[t].badRows;
+  }
+  window->batch = realloc(window->batch, (window->count + 1) * sizeof(Record));
+  int offset = 0;
+  for (int g = 0; g < GROUPS; g++) {
+    for (int t = 0; t < window->threadCount; t++) {
+      window->parts[t].offset[g] = offset;
+      offset += window->parts[t].histogram[g];
+    }
+  }
+  for (int t = 0; t < window->threadCount; t++) {
+    window->parts[t].batch = window->batch;
+    pthread_create(&window->threads[t], NULL, scatterPart, &window->parts[t]);
+  }
+  for (int t = 0; t < window->threadCount; t++)
+    pthread_join(window->threads[t], NULL);
+}
+
+static double now()
+{
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+static void usage(const char* program)
+{
+  fprintf(stderr, "usage: %s [-b] [-l] [-u] [-f bits] [-m records] [-t threads] [-d depth] [-w window MB] input index\n"
+                  "  -b  the input is packed binary Records, otherwise CSV id,name,surname,city\n"
+                  "  -l  create the index with linear hashing\n"
+                  "  -u  upsert, an id that exists is replaced instead of added again\n"
+                  "  -f  keep a Bloom filter of the ids with that many bits per id\n"
+                  "  -m  buffer inserts in memory, that many records a half, and write them out in bucket order\n", program);
+  exit(1);
+}
+
+int main(int argc, char** argv) {
+  bool binary = false, upsert = false;
+  GrowthMode mode = EXTENDIBLE;
+  int threadCount = sysconf(_SC_NPROCESSORS_ONLN), depth = 2, bloomBits = 0, bufferRecords = 0;
+  long window = WINDOW_MB;
+  int option;
+  while ((option = getopt(argc, argv, "bluf:m:t:d:w:")) != -1) {
+    switch (option) {
+      case 'b': binary = true; break;
+      case 'l': mode = LINEAR; break;
+      case 'u': upsert = true; break;
+      case 'f': bloomBits = atoi(optarg); break;
+      case 'm': bufferRecords = atoi(optarg); break;
+      case 't': threadCount = atoi(optarg); break;
+      case 'd': depth = atoi(optarg); break;
+      case 'w': window = atol(optarg); break;
+      default: usage(argv[0]);
+    }
+  }
+  if (argc - optind != 2 || window <= 0)
+    usage(argv[0]);
+  if (threadCount < 1)
+    threadCount = 1;
+  if (threadCount > MAX_THREADS)
+    threadCount = MAX_THREADS;
+  window *= 1 << 20;
+  const char* input = argv[optind];
+  const char* fileName = argv[optind + 1];
+
+  int fd = open(input, O_RDONLY);
+  struct stat st;
+  if (fd == -1 || fstat(fd, &st) != 0) {
+    perror(input);
+    return 1;
+  }
+  const char* data = NULL;
+  if (st.st_size > 0) {
+    data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+      perror(input);
+      return 1;
+    }
+    madvise((void*)data, st.st_size, MADV_SEQUENTIAL);
+  }
+  const char* end = data + st.st_size;
+
+  CALL_OR_DIE(HT_Init());
+  int indexDesc;
+  if (access(fileName, F_OK) != 0) // a new index, an existing one gets the records added
+    CALL_OR_DIE(HT_CreateIndexMode(fileName, depth, mode));
+  CALL_OR_DIE(HT_OpenIndex(fileName, &indexDesc));
+  HT_Summary summary;
+  CALL_OR_DIE(HT_GetSummary(indexDesc, &summary));
+  if (summary.clean)
+    printf("Opened '%s': depth %d, %d buckets, %ld records\n", fileName, summary.depth, summary.buckets, summary.records);
+  else // checked in the background while the records load
+    printf("Opened '%s' after an unclean close, checking its %d blocks\n", fileName, summary.unvalidated);
+  if (bloomBits > 0) // upserts of new ids then skip the bucket lookup
+    CALL_OR_DIE(HT_SetBloomFilter(indexDesc, bloomBits));
+  if (bufferRecords > 0) // upserts of ids still in memory are applied there
+    CALL_OR_DIE(HT_SetWriteBuffer(indexDesc, bufferRecords));
+
+  // two windows: one is parsed while the records of the other are inserted
+  Window* windows = calloc(2, sizeof(Window));
+  windows[0].threadCount = windows[1].threadCount = threadCount;
+  long rows = 0, badRows = 0;
+  double start = now();
+  const char* next = data;
+  int current = 0;
+  bool pending = false;
+  while (next < end || pending) {
+    if (pending)
+      finishParse(&windows[current]);
+    bool parsing = next < end;
+    if (parsing) { // start on the next window, it ends on a line or a record boundary
+      const char* to = end - next > window ? next + window : end;
+      if (binary)
+        to = next + (to - next) / sizeof(Record) * sizeof(Record);
+      else if (to < end) {
+        const char* newline = memchr(to, '\n', end - to);
+        to = newline == NULL ? end : newline + 1;
+      }
+      if (to == next) { // a trailing piece smaller than a record
+        badRows++;
+        next = end;
+        parsing = false;
+      } else {
+        startParse(&windows[1 - current], next, to, binary);
+        next = to;
+      }
+    }
+    if (pending) {
+      Window* batch = &windows[current];
+      for (int i = 0; i < batch->count; i++)
+        CALL_OR_DIE(upsert ? HT_Upsert(indexDesc, batch->batch[i]) : HT_InsertEntry(indexDesc, batch->batch[i]));
+      rows += batch->count;
+      badRows += batch->badRows;
+      double elapsed = now() - start;
+      fprintf(stderr, "%ld rows, %.0f rows/s, %.1f%% of the input\n", rows, elapsed > 0 ? rows / elapsed : 0.0,
+              100.0 * (next - data) / st.st_size);
+    }
+    pending = parsing;
+    current = 1 - current;
+  }
+
+  double elapsed = now() - start;
+  printf("Loaded %ld rows into '%s' in %.2f s (%.0f rows/s)", rows, fileName, elapsed,
+         elapsed > 0 ? rows / elapsed : 0.0);
+  if (badRows != 0)
+    printf(", %ld lines skipped", badRows);
+  printf("\n");
+
+  for (int w = 0; w < 2; w++) {
+    for (int t = 0; t < threadCount; t++)
+      free(windows[w].parts[t].records);
+    free(windows[w].batch);
+  }
+  free(windows);
+  if (data != NULL)
+    munmap((void*)data, st.st_size);
+  close(fd);
+  CALL_OR_DIE(HT_CloseFile(indexDesc));
+  CALL_OR_DIE(HashStatistics((char*)fileName));
+  BF_Close();
+  return 0;
+}
@@ -92,7 +92,11 @@ int main() {
   CALL_OR_DIE(HT_PrintAllEntries(indexDesc, &id));
   //CALL_OR_DIE(HT_PrintAllEntries(indexDesc, NULL));
 
+  printf("RUN HT_Compact\n");
+  CALL_OR_DIE(HT_Compact(indexDesc));
+
   CALL_OR_DIE(HashStatistics(FILE_NAME));
+  HT_PrintMetrics();
 
   CALL_OR_DIE(HT_CloseFile(indexDesc));
   BF_Close();
@@ -0,0 +1,105 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "bf.h"
+#include "packed_file.h"
+
+#define RECORDS_NUM 1000 // you can change it if you want
+#define GLOBAL_DEPT 2 // you can change it if you want
+#define FILE_NAME "data.db"
+#define PACKED_NAME "data.pk"
+
+const char* names[] = {
+  "Yannis",
+  "Christofos",
+  "Sofia",
+  "Marianna",
+  "Vagelis",
+  "Maria",
+  "Iosif",
+  "Dionisis",
+  "Konstantina",
+  "Theofilos",
+  "Giorgos",
+  "Dimitris"
+};
+
+const char* surnames[] = {
+  "Ioannidis",
+  "Svingos",
+  "Karvounari",
+  "Rezkalla",
+  "Nikolopoulos",
+  "Berreta",
+  "Koronis",
+  "Gaitanis",
+  "Oikonomou",
+  "Mailis",
+  "Michas",
+  "Halatsis"
+};
+
+const char* cities[] = {
+  "Athens",
+  "San Francisco",
+  "Los Angeles",
+  "Amsterdam",
+  "London",
+  "New York",
+  "Tokyo",
+  "Hong Kong",
+  "Munich",
+  "Miami"
+};
+
+#define CALL_OR_DIE(call)     \
+  {                           \
+    HT_ErrorCode code = call; \
+    if (code != HT_OK) {      \
+      printf("Error\n");      \
+      exit(code);             \
+    }                         \
+  }
+
+int main() {
+  CALL_OR_DIE(HT_Init());
+
+  int indexDesc;
+  CALL_OR_DIE(HT_CreateIndex(FILE_NAME, GLOBAL_DEPT));
+  CALL_OR_DIE(HT_OpenIndex(FILE_NAME, &indexDesc));
+
+  Record record;
+  srand(12569874);
+  int r;
+  printf("Insert Entries\n");
+  for (int id = 0; id < RECORDS_NUM; ++id) {
+    // create a record
+    record.id = id;
+    r = rand() % 12;
+    memcpy(record.name, names[r], strlen(names[r]) + 1);
+    r = rand() % 12;
+    memcpy(record.surname, surnames[r], strlen(surnames[r]) + 1);
+    r = rand() % 10;
+    memcpy(record.city, cities[r], strlen(cities[r]) + 1);
+
+    CALL_OR_DIE(HT_InsertEntry(indexDesc, record));
+  }
+
+  printf("Compress\n");
+  CALL_OR_DIE(HT_Compress(indexDesc, PACKED_NAME));
+  CALL_OR_DIE(HashStatistics(FILE_NAME));
+  CALL_OR_DIE(HT_CloseFile(indexDesc));
+
+  int packedDesc;
+  CALL_OR_DIE(PK_OpenIndex(PACKED_NAME, &packedDesc));
+  printf("RUN PK_ReadPage\n");
+  Record records[MAX_RECORDS];
+  int count;
+  CALL_OR_DIE(PK_ReadPage(packedDesc, 0, records, &count));
+  for (int i = 0; i < count; i++)
+    printf("ID: %d, name: %s, surname: %s, city: %s\n", records[i].id, records[i].name, records[i].surname, records[i].city);
+  CALL_OR_DIE(PK_CloseFile(packedDesc));
+  CALL_OR_DIE(PackedStatistics(PACKED_NAME));
+  BF_Close();
+}
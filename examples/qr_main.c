@@ -0,0 +1,113 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "bf.h"
+#include "query_file.h"
+
+#define RECORDS_NUM 1000 // you can change it if you want
+#define GLOBAL_DEPT 2 // you can change it if you want
+#define FILE_NAME "query.db"
+
+const char* names[] = {
+  "Yannis",
+  "Christofos",
+  "Sofia",
+  "Marianna",
+  "Vagelis",
+  "Maria",
+  "Iosif",
+  "Dionisis",
+  "Konstantina",
+  "Theofilos",
+  "Giorgos",
+  "Dimitris"
+};
+
+const char* surnames[] = {
+  "Ioannidis",
+  "Svingos",
+  "Karvounari",
+  "Rezkalla",
+  "Nikolopoulos",
+  "Berreta",
+  "Koronis",
+  "Gaitanis",
+  "Oikonomou",
+  "Mailis",
+  "Michas",
+  "Halatsis"
+};
+
+const char* cities[] = {
+  "Athens",
+  "San Francisco",
+  "Los Angeles",
+  "Amsterdam",
+  "London",
+  "New York",
+  "Tokyo",
+  "Hong Kong",
+  "Munich",
+  "Miami"
+};
+
+#define CALL_OR_DIE(call)     \
+  {                           \
+    HT_ErrorCode code = call; \
+    if (code != HT_OK) {      \
+      printf("Error\n");      \
+      exit(code);             \
+    }                         \
+  }
+
+int main() {
+  CALL_OR_DIE(HT_Init());
+
+  int indexDesc;
+  CALL_OR_DIE(HT_CreateIndex(FILE_NAME, GLOBAL_DEPT));
+  CALL_OR_DIE(HT_OpenIndex(FILE_NAME, &indexDesc));
+
+  Record record;
+  srand(12569874);
+  int r;
+  printf("Insert Entries\n");
+  for (int id = 0; id < RECORDS_NUM; ++id) {
+    // create a record
+    record.id = id;
+    r = rand() % 12;
+    memcpy(record.name, names[r], strlen(names[r]) + 1);
+    r = rand() % 12;
+    memcpy(record.surname, surnames[r], strlen(surnames[r]) + 1);
+    r = rand() % 10;
+    memcpy(record.city, cities[r], strlen(cities[r]) + 1);
+
+    CALL_OR_DIE(HT_InsertEntry(indexDesc, record));
+  }
+
+  Query query;
+  QueryResult result;
+  printf("Count by city\n");
+  QR_InitQuery(&query);
+  query.groupBy = COLUMN_CITY;
+  CALL_OR_DIE(QR_Run(indexDesc, &query, &result));
+  for (int g = 0; g < result.groupCount; g++)
+    printf("%s: %d records, ids %d to %d\n", result.groups[g].key, result.groups[g].count,
+           result.groups[g].minId, result.groups[g].maxId);
+  QR_FreeResult(&result);
+
+  printf("Name and city of the records with id 100 to 199 and surname starting with Ko\n");
+  QR_InitQuery(&query);
+  query.minId = 100;
+  query.maxId = 199;
+  query.projection = FIELD_NAME | FIELD_CITY;
+  CALL_OR_DIE(QR_AddPredicate(&query, COLUMN_SURNAME, PRED_PREFIX, "Ko"));
+  CALL_OR_DIE(QR_Run(indexDesc, &query, &result));
+  for (int i = 0; i < result.rowCount; i++)
+    printf("ID: %d, name: %s, city: %s\n", result.rows[i].id, result.rows[i].name, result.rows[i].city);
+  printf("%d of %d records\n", result.rowCount, result.scanned);
+  QR_FreeResult(&result);
+
+  CALL_OR_DIE(HT_CloseFile(indexDesc));
+  BF_Close();
+}
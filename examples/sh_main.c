@@ -0,0 +1,97 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "bf.h"
+#include "shard_file.h"
+
+#define RECORDS_NUM 1000 // you can change it if you want
+#define GLOBAL_DEPT 2 // you can change it if you want
+#define SHARDS 4 // you can change it if you want
+#define FILE_NAME "sharded.db"
+
+const char* names[] = {
+  "Yannis",
+  "Christofos",
+  "Sofia",
+  "Marianna",
+  "Vagelis",
+  "Maria",
+  "Iosif",
+  "Dionisis",
+  "Konstantina",
+  "Theofilos",
+  "Giorgos",
+  "Dimitris"
+};
+
+const char* surnames[] = {
+  "Ioannidis",
+  "Svingos",
+  "Karvounari",
+  "Rezkalla",
+  "Nikolopoulos",
+  "Berreta",
+  "Koronis",
+  "Gaitanis",
+  "Oikonomou",
+  "Mailis",
+  "Michas",
+  "Halatsis"
+};
+
+const char* cities[] = {
+  "Athens",
+  "San Francisco",
+  "Los Angeles",
+  "Amsterdam",
+  "London",
+  "New York",
+  "Tokyo",
+  "Hong Kong",
+  "Munich",
+  "Miami"
+};
+
+#define CALL_OR_DIE(call)     \
+  {                           \
+    HT_ErrorCode code = call; \
+    if (code != HT_OK) {      \
+      printf("Error\n");      \
+      exit(code);             \
+    }                         \
+  }
+
+int main() {
+  CALL_OR_DIE(HT_Init());
+
+  int shardDesc;
+  CALL_OR_DIE(SH_CreateIndex(FILE_NAME, GLOBAL_DEPT, SHARDS));
+  CALL_OR_DIE(SH_OpenIndex(FILE_NAME, &shardDesc));
+
+  Record* records = malloc(RECORDS_NUM * sizeof(Record));
+  srand(12569874);
+  int r;
+  printf("Insert Entries\n");
+  for (int id = 0; id < RECORDS_NUM; ++id) {
+    // create a record
+    records[id].id = id;
+    r = rand() % 12;
+    memcpy(records[id].name, names[r], strlen(names[r]) + 1);
+    r = rand() % 12;
+    memcpy(records[id].surname, surnames[r], strlen(surnames[r]) + 1);
+    r = rand() % 10;
+    memcpy(records[id].city, cities[r], strlen(cities[r]) + 1);
+  }
+  CALL_OR_DIE(SH_InsertEntries(shardDesc, records, RECORDS_NUM));
+  free(records);
+
+  printf("RUN PrintAllEntries\n");
+  int id = rand() % RECORDS_NUM;
+  CALL_OR_DIE(SH_PrintAllEntries(shardDesc, &id));
+  //CALL_OR_DIE(SH_PrintAllEntries(shardDesc, NULL));
+
+  CALL_OR_DIE(SH_CloseFile(shardDesc));
+  CALL_OR_DIE(ShardStatistics(FILE_NAME));
+  BF_Close();
+}
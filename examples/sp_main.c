@@ -0,0 +1,129 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "bf.h"
+#include "shared_pool.h"
+
+#define RECORDS_NUM 1000 // you can change it if you want
+#define GLOBAL_DEPT 2 // you can change it if you want
+#define FILE_NAME "data.db"
+#define POOL_NAME "/ht_pool"
+#define POOL_FRAMES 64 // fewer than the blocks of the file, so pages get evicted
+#define WORKERS 4
+#define LOOKUPS 2000
+
+const char* names[] = {
+  "Yannis",
+  "Christofos",
+  "Sofia",
+  "Marianna",
+  "Vagelis",
+  "Maria",
+  "Iosif",
+  "Dionisis",
+  "Konstantina",
+  "Theofilos",
+  "Giorgos",
+  "Dimitris"
+};
+
+const char* surnames[] = {
+  "Ioannidis",
+  "Svingos",
+  "Karvounari",
+  "Rezkalla",
+  "Nikolopoulos",
+  "Berreta",
+  "Koronis",
+  "Gaitanis",
+  "Oikonomou",
+  "Mailis",
+  "Michas",
+  "Halatsis"
+};
+
+const char* cities[] = {
+  "Athens",
+  "San Francisco",
+  "Los Angeles",
+  "Amsterdam",
+  "London",
+  "New York",
+  "Tokyo",
+  "Hong Kong",
+  "Munich",
+  "Miami"
+};
+
+#define CALL_OR_DIE(call)     \
+  {                           \
+    HT_ErrorCode code = call; \
+    if (code != HT_OK) {      \
+      printf("Error\n");      \
+      exit(code);             \
+    }                         \
+  }
+
+int main() {
+  CALL_OR_DIE(HT_Init());
+
+  int indexDesc;
+  CALL_OR_DIE(HT_CreateIndex(FILE_NAME, GLOBAL_DEPT));
+  CALL_OR_DIE(HT_OpenIndex(FILE_NAME, &indexDesc));
+
+  Record record;
+  srand(12569874);
+  int r;
+  printf("Insert Entries\n");
+  for (int id = 0; id < RECORDS_NUM; ++id) {
+    // create a record
+    record.id = id;
+    r = rand() % 12;
+    memcpy(record.name, names[r], strlen(names[r]) + 1);
+    r = rand() % 12;
+    memcpy(record.surname, surnames[r], strlen(surnames[r]) + 1);
+    r = rand() % 10;
+    memcpy(record.city, cities[r], strlen(cities[r]) + 1);
+
+    CALL_OR_DIE(HT_InsertEntry(indexDesc, record));
+  }
+  CALL_OR_DIE(HT_CloseFile(indexDesc));
+  BF_Close();
+
+  // every worker attaches on its own, the first creates the pool and the others find it warm
+  printf("Start %d workers\n", WORKERS);
+  fflush(stdout);
+  for (int w = 0; w < WORKERS; w++) {
+    if (fork() == 0) {
+      int sharedDesc, missing = 0;
+      CALL_OR_DIE(SP_Attach(POOL_NAME, POOL_FRAMES));
+      CALL_OR_DIE(SP_OpenIndex(FILE_NAME, &sharedDesc));
+      srand(w);
+      for (int i = 0; i < LOOKUPS; i++) {
+        Record found[MAX_RECORDS];
+        int count;
+        CALL_OR_DIE(SP_Lookup(sharedDesc, rand() % RECORDS_NUM, found, MAX_RECORDS, &count));
+        missing += count == 0;
+      }
+      printf("Worker %d: %d lookups, %d missing\n", w, LOOKUPS, missing);
+      fflush(stdout);
+      CALL_OR_DIE(SP_CloseFile(sharedDesc));
+      CALL_OR_DIE(SP_Detach(false));
+      exit(0);
+    }
+  }
+  for (int w = 0; w < WORKERS; w++)
+    wait(NULL);
+
+  int sharedDesc;
+  CALL_OR_DIE(SP_Attach(POOL_NAME, POOL_FRAMES));
+  CALL_OR_DIE(SP_OpenIndex(FILE_NAME, &sharedDesc));
+  printf("RUN SP_PrintAllEntries\n");
+  int id = rand() % RECORDS_NUM;
+  CALL_OR_DIE(SP_PrintAllEntries(sharedDesc, &id));
+  CALL_OR_DIE(SharedStatistics());
+  CALL_OR_DIE(SP_Detach(true));
+}
@@ -0,0 +1,81 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bf.h"
+#include "hash_file.h"
+
+#define BUFFER_RECORDS 4 // records of a half of the write buffer
+#define REPEATED_ID 5
+#define GLOBAL_DEPT 2 // you can change it if you want
+#define FILE_NAME "buffered.db"
+
+#define CALL_OR_DIE(call)     \
+  {                           \
+    HT_ErrorCode code = call; \
+    if (code != HT_OK) {      \
+      printf("Error\n");      \
+      exit(code);             \
+    }                         \
+  }
+
+typedef struct Copies {
+  int total; // records with the repeated id
+  int stale; // of them not changed by the upsert and the update
+} Copies;
+
+static void countCopies(const Record *records, int count, void *ctx)
+{
+  Copies *copies = ctx;
+  for (int i = 0; i < count; i++) {
+    if (records[i].id != REPEATED_ID)
+      continue;
+    copies->total++;
+    if (strcmp(records[i].name, "New") != 0 || strcmp(records[i].city, "Patras") != 0)
+      copies->stale++;
+  }
+}
+
+// an id with one copy already in the file and one still in the write buffer: an upsert and an
+// update change both, not only the buffered one
+int main() {
+  CALL_OR_DIE(HT_Init());
+
+  int indexDesc;
+  remove(FILE_NAME); // a new file every run
+  CALL_OR_DIE(HT_CreateIndex(FILE_NAME, GLOBAL_DEPT));
+  CALL_OR_DIE(HT_OpenIndex(FILE_NAME, &indexDesc));
+  CALL_OR_DIE(HT_SetWriteBuffer(indexDesc, BUFFER_RECORDS));
+
+  Record record;
+  memset(&record, 0, sizeof(Record));
+  record.id = REPEATED_ID;
+  strcpy(record.name, "Old");
+  strcpy(record.surname, "Copy");
+  strcpy(record.city, "Athens");
+  printf("Insert Entries\n");
+  CALL_OR_DIE(HT_InsertEntry(indexDesc, record));
+  CALL_OR_DIE(HT_Flush(indexDesc)); // the first copy is in the file
+  strcpy(record.name, "Dup");
+  CALL_OR_DIE(HT_InsertEntry(indexDesc, record)); // the second one stays in memory
+
+  printf("RUN Upsert\n");
+  strcpy(record.name, "New");
+  CALL_OR_DIE(HT_Upsert(indexDesc, record));
+  printf("RUN UpdateFields\n");
+  strcpy(record.city, "Patras");
+  CALL_OR_DIE(HT_UpdateFields(indexDesc, REPEATED_ID, FIELD_CITY, &record));
+  int id = REPEATED_ID;
+  CALL_OR_DIE(HT_PrintAllEntries(indexDesc, &id));
+
+  CALL_OR_DIE(HT_Flush(indexDesc));
+  Copies copies = { 0, 0 };
+  CALL_OR_DIE(HT_ScanPages(indexDesc, countCopies, &copies));
+  printf("%d copies, %d stale\n", copies.total, copies.stale);
+  if (copies.total != 2 || copies.stale != 0) {
+    printf("Error\n");
+    exit(1);
+  }
+
+  CALL_OR_DIE(HT_CloseFile(indexDesc));
+  BF_Close();
+}
@@ -0,0 +1,80 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "extendible_hash_file.hpp"
+
+#define RECORDS_NUM 1000 // you can change it if you want
+#define GLOBAL_DEPT 2 // you can change it if you want
+
+#define CALL_OR_DIE(call)     \
+  {                           \
+    HT_ErrorCode code = call; \
+    if (code != HT_OK) {      \
+      printf("Error\n");      \
+      exit(code);             \
+    }                         \
+  }
+
+// a table with 64-bit ids
+struct Account {
+  double balance;
+  char owner[24];
+};
+
+// a table with a composite key
+struct Visit {
+  int patient;
+  int day;
+  bool operator==(const Visit &other) const { return patient == other.patient && day == other.day; }
+};
+
+struct VisitHash {
+  std::uint32_t operator()(const Visit &visit) const {
+    return static_cast<std::uint32_t>(visit.patient) * 2654435761u ^ static_cast<std::uint32_t>(visit.day);
+  }
+};
+
+typedef ht::ExtendibleHashFile<std::int64_t, Account> Accounts;
+typedef ht::ExtendibleHashFile<Visit, int, VisitHash> Visits;
+
+int main() {
+  BF_Init(LRU);
+  printf("Accounts: %d entries per bucket, %d slots per directory page, depth up to %d\n",
+         Accounts::kBucketCapacity, Accounts::kFanout, Accounts::kMaxDepth);
+  printf("Visits: %d entries per bucket, %d slots per directory page, depth up to %d\n",
+         Visits::kBucketCapacity, Visits::kFanout, Visits::kMaxDepth);
+
+  CALL_OR_DIE(Accounts::Create("accounts.db", GLOBAL_DEPT));
+  CALL_OR_DIE(Visits::Create("visits.db", GLOBAL_DEPT));
+  {
+    Accounts accounts;
+    Visits visits;
+    CALL_OR_DIE(accounts.Open("accounts.db"));
+    CALL_OR_DIE(visits.Open("visits.db"));
+
+    srand(12569874);
+    printf("Insert Entries\n");
+    for (int i = 0; i < RECORDS_NUM; ++i) {
+      std::int64_t id = (static_cast<std::int64_t>(rand()) << 32) | i;
+      Account account;
+      memset(&account, 0, sizeof(account));
+      account.balance = rand() % 10000 / 100.0;
+      snprintf(account.owner, sizeof(account.owner), "owner %d", i);
+      CALL_OR_DIE(accounts.Insert(id, account));
+      CALL_OR_DIE(visits.Insert(Visit{ i % 100, i / 100 }, rand() % 500));
+    }
+
+    printf("RUN Find\n");
+    Visit visit = { 42, 3 };
+    CALL_OR_DIE(visits.Find(visit, [&](int cost) { printf("patient %d, day %d: cost %d\n", visit.patient, visit.day, cost); }));
+    double total = 0;
+    int count = 0;
+    CALL_OR_DIE(accounts.ForEach([&](std::int64_t, const Account &account) {
+      total += account.balance;
+      count++;
+    }));
+    printf("%d accounts, balance %.2f, global depth %d\n", count, total, accounts.depth());
+  }
+  BF_Close();
+}
@@ -0,0 +1,451 @@
+#ifndef EXTENDIBLE_HASH_FILE_HPP
+#define EXTENDIBLE_HASH_FILE_HPP
+
+// Extendible hashing over the BF layer for any trivially copyable key and value. The bucket
+// capacity, the slots of a directory page and the extents of the directory are constants of the
+// types and the page size, so every table gets its own split and lookup code instead of a copy of
+// hash_file.c. The directory is laid out in extents like the one of hash_file.c, so its depth reaches 31
+// instead of stopping at the pages the first block can list.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+#include "bf.h"
+#include "hash_file.h"
+
+namespace ht {
+
+namespace detail {
+
+constexpr int floorLog2(std::size_t n) { return n < 2 ? 0 : 1 + floorLog2(n / 2); }
+constexpr std::size_t roundUp(std::size_t n, std::size_t align) { return (n + align - 1) / align * align; }
+
+} // namespace detail
+
+// the hash of a key, its low bits pick the slot. Specialize it for a composite key
+template <typename Key, typename Enable = void>
+struct KeyHash;
+
+// an id up to 32 bits is its own hash, like hashFunction of hash_file.c
+template <typename Key>
+struct KeyHash<Key, typename std::enable_if<std::is_integral<Key>::value && sizeof(Key) <= 4>::type> {
+  std::uint32_t operator()(Key key) const { return static_cast<std::uint32_t>(key); }
+};
+
+// a 64-bit id is mixed, ids that differ only in the high half would otherwise share a slot
+template <typename Key>
+struct KeyHash<Key, typename std::enable_if<std::is_integral<Key>::value && sizeof(Key) == 8>::type> {
+  std::uint32_t operator()(Key key) const {
+    return static_cast<std::uint32_t>((static_cast<std::uint64_t>(key) * 0x9E3779B97F4A7C15ULL) >> 32);
+  }
+};
+
+template <typename Key, typename Value, typename Hash = KeyHash<Key>, std::size_t PageSize = BF_BLOCK_SIZE>
+class ExtendibleHashFile {
+  static_assert(PageSize <= BF_BLOCK_SIZE, "a page has to fit in a block of the BF layer");
+  static_assert((PageSize & (PageSize - 1)) == 0, "the slots of a directory page have to be a power of two");
+  static_assert(std::is_trivially_copyable<Key>::value && std::is_trivially_copyable<Value>::value,
+                "entries are copied into the pages as bytes");
+
+ public:
+  struct Entry {
+    Key key;
+    Value value;
+  };
+
+  struct BucketHeader {
+    int count;
+    int localDepth;
+    int overflow; // next block of a bucket that holds a single key or is at kMaxDepth, -1 if none
+  };
+
+  static constexpr int kBucketCapacity =
+      static_cast<int>((PageSize - detail::roundUp(sizeof(BucketHeader), alignof(Entry))) / sizeof(Entry));
+  static constexpr int kFanout = static_cast<int>(PageSize / sizeof(int)); // slots in a page of the directory
+
+  struct InfoHeader {
+    int magic;
+    int depth;
+    int segments; // extents of the directory
+  };
+
+  // extent 0 is one page and extent i > 0 the 2^(i-1) pages after it. Enough of them for 2^31 slots,
+  // unless the first block of a small page has no room for that many
+  static constexpr int kMaxSegments =
+      31 - detail::floorLog2(kFanout) + 1 < static_cast<int>((PageSize - sizeof(InfoHeader)) / sizeof(int))
+          ? 31 - detail::floorLog2(kFanout) + 1 : static_cast<int>((PageSize - sizeof(InfoHeader)) / sizeof(int));
+  static constexpr int kMaxDepth = detail::floorLog2(kFanout) + kMaxSegments - 1;
+
+  struct Bucket {
+    BucketHeader header;
+    Entry entries[kBucketCapacity];
+  };
+
+  struct Info { // first block of the file
+    InfoHeader header;
+    int segment[kMaxSegments]; // first block of every extent, its pages are consecutive blocks
+  };
+
+  static_assert(kBucketCapacity >= 2, "a split needs two entries in a page");
+  static_assert(sizeof(Bucket) <= PageSize && sizeof(Info) <= PageSize, "the layout has to fit in a page");
+
+  ExtendibleHashFile() : fileDesc_(-1) {
+    BF_Block_Init(&block_);
+    BF_Block_Init(&other_);
+  }
+
+  ~ExtendibleHashFile() {
+    Close();
+    BF_Block_Destroy(&block_);
+    BF_Block_Destroy(&other_);
+  }
+
+  ExtendibleHashFile(const ExtendibleHashFile &) = delete;
+  ExtendibleHashFile &operator=(const ExtendibleHashFile &) = delete;
+
+  // create an empty file whose directory has 2^depth slots
+  static HT_ErrorCode Create(const char *fileName, int depth) {
+    if (depth < 1 || depth > kMaxDepth)
+      return HT_ERROR;
+    ExtendibleHashFile file;
+    if (!ok(BF_CreateFile(fileName)) || !ok(BF_OpenFile(fileName, &file.fileDesc_)))
+      return HT_ERROR;
+    int block;
+    if (!file.allocate(file.block_, &block)) // block 0
+      return HT_ERROR;
+    if (!ok(BF_UnpinBlock(file.block_)))
+      return HT_ERROR;
+    std::memset(&file.info_, 0, sizeof(Info));
+    file.info_.header.magic = kMagic;
+    file.info_.header.depth = depth;
+    do {
+      if (file.addSegment(false) != HT_OK) // every slot without a bucket
+        return HT_ERROR;
+    } while (static_cast<std::int64_t>(pagesOf(file.info_.header.segments)) * kFanout < (std::int64_t{1} << depth));
+    if (file.writeInfo() != HT_OK)
+      return HT_ERROR;
+    return file.Close();
+  }
+
+  HT_ErrorCode Open(const char *fileName) {
+    if (fileDesc_ != -1 || !ok(BF_OpenFile(fileName, &fileDesc_)))
+      return HT_ERROR;
+    if (!ok(BF_GetBlock(fileDesc_, 0, block_)))
+      return HT_ERROR;
+    std::memcpy(&info_, BF_Block_GetData(block_), sizeof(Info));
+    if (!ok(BF_UnpinBlock(block_)) || info_.header.magic != kMagic) {
+      Close();
+      return HT_ERROR;
+    }
+    return HT_OK;
+  }
+
+  HT_ErrorCode Close() {
+    if (fileDesc_ == -1)
+      return HT_OK;
+    int fileDesc = fileDesc_;
+    fileDesc_ = -1;
+    return ok(BF_CloseFile(fileDesc)) ? HT_OK : HT_ERROR;
+  }
+
+  int depth() const { return info_.header.depth; }
+
+  HT_ErrorCode Insert(const Key &key, const Value &value) {
+    if (fileDesc_ == -1)
+      return HT_ERROR;
+    for (;;) { // a split or a doubling, then the key is placed again
+      int slot = slotOf(key);
+      int bucketDesc;
+      if (readSlot(slot, &bucketDesc) != HT_OK)
+        return HT_ERROR;
+      if (bucketDesc == -1)
+        return newBucket(slot, key, value);
+
+      if (!ok(BF_GetBlock(fileDesc_, bucketDesc, block_)))
+        return HT_ERROR;
+      Bucket *bucket = bucketOf(block_);
+      if (bucket->header.count < kBucketCapacity) {
+        bucket->entries[bucket->header.count++] = Entry{ key, value };
+        BF_Block_SetDirty(block_);
+        return ok(BF_UnpinBlock(block_)) ? HT_OK : HT_ERROR;
+      }
+      int localDepth = bucket->header.localDepth;
+      bool sameKey = true;
+      for (int i = 0; i < bucket->header.count && sameKey; i++)
+        sameKey = bucket->entries[i].key == key;
+      if (!ok(BF_UnpinBlock(block_)))
+        return HT_ERROR;
+
+      if (sameKey) // no split can separate them
+        return chainInsert(bucketDesc, key, value);
+      if (localDepth < depth()) {
+        if (split(slot, bucketDesc) != HT_OK)
+          return HT_ERROR;
+      } else if (depth() < kMaxDepth) {
+        if (doubleDirectory() != HT_OK)
+          return HT_ERROR;
+      } else { // the directory is as large as it gets
+        return chainInsert(bucketDesc, key, value);
+      }
+    }
+  }
+
+  // call found(value) for every entry with the key, in one pass over its bucket
+  template <typename Callback>
+  HT_ErrorCode Find(const Key &key, Callback found) {
+    if (fileDesc_ == -1)
+      return HT_ERROR;
+    int bucketDesc;
+    if (readSlot(slotOf(key), &bucketDesc) != HT_OK)
+      return HT_ERROR;
+    while (bucketDesc != -1) {
+      if (!ok(BF_GetBlock(fileDesc_, bucketDesc, block_)))
+        return HT_ERROR;
+      const Bucket *bucket = bucketOf(block_);
+      for (int i = 0; i < bucket->header.count; i++) {
+        if (bucket->entries[i].key == key)
+          found(bucket->entries[i].value);
+      }
+      bucketDesc = bucket->header.overflow;
+      if (!ok(BF_UnpinBlock(block_)))
+        return HT_ERROR;
+    }
+    return HT_OK;
+  }
+
+  // the first value with the key, found is false if there is none
+  HT_ErrorCode Get(const Key &key, Value *value, bool *found) {
+    *found = false;
+    return Find(key, [&](const Value &v) {
+      if (!*found)
+        *value = v;
+      *found = true;
+    });
+  }
+
+  // call visit(key, value) for every entry, reading every bucket page once in the order of the blocks
+  template <typename Callback>
+  HT_ErrorCode ForEach(Callback visit) {
+    int blocks;
+    if (fileDesc_ == -1 || !ok(BF_GetBlockCounter(fileDesc_, &blocks)))
+      return HT_ERROR;
+    std::vector<char> directory(blocks, 0);
+    directory[0] = 1;
+    for (int s = 0; s < info_.header.segments; s++) {
+      int length = s == 0 ? 1 : pagesOf(s);
+      std::memset(&directory[info_.segment[s]], 1, length);
+    }
+    for (int b = 0; b < blocks; b++) {
+      if (directory[b])
+        continue;
+      if (!ok(BF_GetBlock(fileDesc_, b, block_)))
+        return HT_ERROR;
+      const Bucket *bucket = bucketOf(block_);
+      for (int i = 0; i < bucket->header.count; i++)
+        visit(bucket->entries[i].key, bucket->entries[i].value);
+      if (!ok(BF_UnpinBlock(block_)))
+        return HT_ERROR;
+    }
+    return HT_OK;
+  }
+
+ private:
+  static constexpr int kMagic = 0x32485848; // "HXH2", the directory in extents
+
+  static bool ok(BF_ErrorCode code) {
+    if (code == BF_OK)
+      return true;
+    BF_PrintError(code);
+    return false;
+  }
+
+  static Bucket *bucketOf(BF_Block *block) { return reinterpret_cast<Bucket *>(BF_Block_GetData(block)); }
+
+  int slotOf(const Key &key) const { return static_cast<int>(Hash()(key) & ((1u << depth()) - 1)); }
+
+  // pages of the directory in the given number of extents
+  static int pagesOf(int segments) { return segments == 0 ? 0 : 1 << (segments - 1); }
+
+  // the block of the directory page that holds a slot, found by arithmetic on the extents
+  int pageBlock(int slot) const {
+    int page = slot / kFanout;
+    int segment = page == 0 ? 0 : detail::floorLog2(static_cast<std::size_t>(page)) + 1;
+    return info_.segment[segment] + page - pagesOf(segment);
+  }
+
+  // a new block at the end of the file, pinned in block
+  bool allocate(BF_Block *block, int *blockNum) {
+    return ok(BF_GetBlockCounter(fileDesc_, blockNum)) && ok(BF_AllocateBlock(fileDesc_, block));
+  }
+
+  HT_ErrorCode writeInfo() {
+    if (!ok(BF_GetBlock(fileDesc_, 0, other_)))
+      return HT_ERROR;
+    std::memcpy(BF_Block_GetData(other_), &info_, sizeof(Info));
+    BF_Block_SetDirty(other_);
+    return ok(BF_UnpinBlock(other_)) ? HT_OK : HT_ERROR;
+  }
+
+  // append the next extent of the directory as consecutive blocks at the end of the file, either
+  // empty or as a copy of all the pages before it (the buddies when doubling)
+  HT_ErrorCode addSegment(bool copy) {
+    int segments = info_.header.segments;
+    int pages = segments == 0 ? 1 : pagesOf(segments);
+    for (int p = 0; p < pages; p++) {
+      int blockNum;
+      if (!allocate(other_, &blockNum))
+        return HT_ERROR;
+      if (p == 0)
+        info_.segment[segments] = blockNum;
+      if (!copy) {
+        std::memset(BF_Block_GetData(other_), -1, PageSize);
+      } else {
+        if (!ok(BF_GetBlock(fileDesc_, pageBlock(p * kFanout), block_)))
+          return HT_ERROR;
+        std::memcpy(BF_Block_GetData(other_), BF_Block_GetData(block_), PageSize);
+        if (!ok(BF_UnpinBlock(block_)))
+          return HT_ERROR;
+      }
+      BF_Block_SetDirty(other_);
+      if (!ok(BF_UnpinBlock(other_)))
+        return HT_ERROR;
+    }
+    info_.header.segments = segments + 1;
+    return HT_OK;
+  }
+
+  HT_ErrorCode readSlot(int slot, int *bucketDesc) {
+    if (!ok(BF_GetBlock(fileDesc_, pageBlock(slot), other_)))
+      return HT_ERROR;
+    *bucketDesc = reinterpret_cast<const int *>(BF_Block_GetData(other_))[slot % kFanout];
+    return ok(BF_UnpinBlock(other_)) ? HT_OK : HT_ERROR;
+  }
+
+  // point the slots first, first + step, ... of the directory to bucketDesc, one pin per page
+  HT_ErrorCode pointSlots(int first, std::int64_t step, int bucketDesc) {
+    std::int64_t size = std::int64_t{1} << depth();
+    for (std::int64_t slot = first; slot < size;) {
+      std::int64_t page = slot / kFanout;
+      if (!ok(BF_GetBlock(fileDesc_, pageBlock(static_cast<int>(slot)), other_)))
+        return HT_ERROR;
+      int *slots = reinterpret_cast<int *>(BF_Block_GetData(other_));
+      for (; slot < size && slot / kFanout == page; slot += step)
+        slots[slot % kFanout] = bucketDesc;
+      BF_Block_SetDirty(other_);
+      if (!ok(BF_UnpinBlock(other_)))
+        return HT_ERROR;
+    }
+    return HT_OK;
+  }
+
+  HT_ErrorCode newBucket(int slot, const Key &key, const Value &value) {
+    int bucketDesc;
+    if (!allocate(block_, &bucketDesc))
+      return HT_ERROR;
+    Bucket *bucket = bucketOf(block_);
+    bucket->header.count = 1;
+    bucket->header.localDepth = depth();
+    bucket->header.overflow = -1;
+    bucket->entries[0] = Entry{ key, value };
+    BF_Block_SetDirty(block_);
+    if (!ok(BF_UnpinBlock(block_)))
+      return HT_ERROR;
+    return pointSlots(slot, std::int64_t{1} << depth(), bucketDesc);
+  }
+
+  // a full bucket that no split can help gets the entry in its first overflow block with space, or a new one at the end
+  HT_ErrorCode chainInsert(int bucketDesc, const Key &key, const Value &value) {
+    for (int current = bucketDesc;;) {
+      if (!ok(BF_GetBlock(fileDesc_, current, block_)))
+        return HT_ERROR;
+      Bucket *bucket = bucketOf(block_);
+      if (bucket->header.count < kBucketCapacity) {
+        bucket->entries[bucket->header.count++] = Entry{ key, value };
+        BF_Block_SetDirty(block_);
+        return ok(BF_UnpinBlock(block_)) ? HT_OK : HT_ERROR;
+      }
+      if (bucket->header.overflow != -1) {
+        current = bucket->header.overflow;
+        if (!ok(BF_UnpinBlock(block_)))
+          return HT_ERROR;
+        continue;
+      }
+      int next;
+      if (!allocate(other_, &next))
+        return HT_ERROR;
+      Bucket *overflow = bucketOf(other_);
+      overflow->header.count = 1;
+      overflow->header.localDepth = bucket->header.localDepth;
+      overflow->header.overflow = -1;
+      overflow->entries[0] = Entry{ key, value };
+      bucket->header.overflow = next;
+      BF_Block_SetDirty(other_);
+      BF_Block_SetDirty(block_);
+      return ok(BF_UnpinBlock(other_)) && ok(BF_UnpinBlock(block_)) ? HT_OK : HT_ERROR;
+    }
+  }
+
+  // split a bucket on bit localDepth of the hash, the slots of one side point to a new bucket
+  HT_ErrorCode split(int slot, int bucketDesc) {
+    int newDesc;
+    if (!ok(BF_GetBlock(fileDesc_, bucketDesc, block_)) || !allocate(other_, &newDesc))
+      return HT_ERROR;
+    Bucket *bucket = bucketOf(block_);
+    Bucket *newBucket = bucketOf(other_);
+    int localDepth = bucket->header.localDepth;
+    int newSide = 1; // the entries with the bit set move
+    newBucket->header.count = 0;
+    newBucket->header.localDepth = localDepth + 1;
+    newBucket->header.overflow = -1;
+    bucket->header.localDepth = localDepth + 1;
+    if (bucket->header.overflow != -1) {
+      // a chain holds a single key and stays together, the new bucket takes the other side
+      newSide = !((Hash()(bucket->entries[0].key) >> localDepth) & 1);
+    } else {
+      int kept = 0;
+      for (int i = 0; i < bucket->header.count; i++) {
+        const Entry &entry = bucket->entries[i];
+        if ((Hash()(entry.key) >> localDepth) & 1)
+          newBucket->entries[newBucket->header.count++] = entry;
+        else
+          bucket->entries[kept++] = entry;
+      }
+      bucket->header.count = kept;
+    }
+    BF_Block_SetDirty(block_);
+    BF_Block_SetDirty(other_);
+    if (!ok(BF_UnpinBlock(block_)) || !ok(BF_UnpinBlock(other_)))
+      return HT_ERROR;
+    int first = (slot & ((1 << localDepth) - 1)) | (newSide << localDepth);
+    return pointSlots(first, std::int64_t{1} << (localDepth + 1), newDesc);
+  }
+
+  // double the directory, every new slot points where its buddy does
+  HT_ErrorCode doubleDirectory() {
+    int size = 1 << depth();
+    if (2 * size <= kFanout) {
+      if (!ok(BF_GetBlock(fileDesc_, info_.segment[0], block_)))
+        return HT_ERROR;
+      int *slots = reinterpret_cast<int *>(BF_Block_GetData(block_));
+      std::memcpy(slots + size, slots, size * sizeof(int));
+      BF_Block_SetDirty(block_);
+      if (!ok(BF_UnpinBlock(block_)))
+        return HT_ERROR;
+    } else if (addSegment(true) != HT_OK) { // the new extent is a copy of the pages before it
+      return HT_ERROR;
+    }
+    info_.header.depth += 1;
+    return writeInfo();
+  }
+
+  int fileDesc_;
+  Info info_; // copy of the first block, written through on every change
+  BF_Block *block_; // handles kept for the life of the table
+  BF_Block *other_;
+};
+
+} // namespace ht
+
+#endif // EXTENDIBLE_HASH_FILE_HPP
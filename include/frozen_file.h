@@ -0,0 +1,78 @@
+#ifndef FROZEN_FILE_H
+#define FROZEN_FILE_H
+
+#include "hash_file.h"
+
+#define FROZEN_MAGIC 0x5a465448 // "HTFZ"
+#define FROZEN_PAGE_SIZE 4096 // a page of the operating system, a lookup reads one
+#define FROZEN_RECORDS (FROZEN_PAGE_SIZE / (int)sizeof(Record)) // records in a full page
+#define MAX_OPEN_FROZEN 16
+
+typedef struct FrozenHeader{ // first page of a frozen file
+  int magic;
+  int recordCount;
+  int pageCount;  // pages of records, all full but the last
+  int fencePage;  // first page of the fences, the first id of every page of records
+  int dataPage;   // first page of the records, sorted by id
+  int minId;
+  int maxId;
+} FrozenHeader;
+
+typedef struct FrozenFile{ // an open frozen file, served from its mapping
+  const char *map;
+  long size;
+  const FrozenHeader *header;
+  const int *fences;
+  const Record *records;
+} FrozenFile;
+
+/*
+ * Η συνάρτηση HT_Freeze γράφει όλες τις εγγραφές του ανοιχτού αρχείου indexDesc σε ένα νέο αρχείο μόνο για ανάγνωση
+ * με όνομα outFile. Οι εγγραφές ταξινομούνται κατά id και γεμίζουν πυκνά σελίδες των FROZEN_PAGE_SIZE bytes, χωρίς
+ * κατάλογο και κενές θέσεις. Μαζί γράφεται το πρώτο id κάθε σελίδας, ώστε μια αναζήτηση με παρεμβολή να βρίσκει τη
+ * μία σελίδα που διαβάζει.
+ * Σε περίπτωση που εκτελεστεί επιτυχώς επιστρέφεται HT_OK, ενώ σε διαφορετική περίπτωση κάποιος κωδικός λάθους.
+ */
+HT_ErrorCode HT_Freeze(
+	int indexDesc,		/* θέση στον πίνακα με τα ανοιχτά αρχεία */
+	const char *outFile	/* όνομα του νέου αρχείου */
+	);
+
+/*
+ * Η ρουτίνα αυτή ανοίγει ένα αρχείο που έγραψε η HT_Freeze απεικονίζοντάς το στη μνήμη (mmap).
+ * Εάν το αρχείο ανοιχτεί κανονικά, η ρουτίνα επιστρέφει HT_OK, ενώ σε διαφορετική περίπτωση κωδικός λάθους.
+ */
+HT_ErrorCode FZ_OpenIndex(
+	const char *fileName,	/* όνομα αρχείου */
+	int *frozenDesc		/* θέση στον πίνακα με τα ανοιχτά frozen αρχεία που επιστρέφεται */
+	);
+
+/*
+ * Η ρουτίνα αυτή κλείνει το frozen αρχείο στη θέση frozenDesc.
+ */
+HT_ErrorCode FZ_CloseFile(
+	int frozenDesc		/* θέση στον πίνακα με τα ανοιχτά frozen αρχεία */
+	);
+
+/*
+ * Η συνάρτηση FZ_Lookup αντιγράφει στο records έως capacity εγγραφές με κλειδί id και επιστρέφει στο count πόσες
+ * υπάρχουν συνολικά (0 αν το id δεν υπάρχει). Εκτός από διπλότυπα id που περνούν σε επόμενη σελίδα, διαβάζεται μία σελίδα.
+ * Σε περίπτωση που εκτελεστεί επιτυχώς επιστρέφεται HT_OK, ενώ σε διαφορετική περίπτωση κάποιος κωδικός λάθους.
+ */
+HT_ErrorCode FZ_Lookup(
+	int frozenDesc,		/* θέση στον πίνακα με τα ανοιχτά frozen αρχεία */
+	int id,			/* τιμή του πεδίου κλειδιού προς αναζήτηση */
+	Record *records,	/* οι εγγραφές που επιστρέφονται */
+	int capacity,		/* θέσεις στο records */
+	int *count		/* πλήθος εγγραφών με το id */
+	);
+
+/*
+ * Η συνάρτηση FZ_PrintAllEntries εκτυπώνει τις εγγραφές με κλειδί id, ή όλες με τη σειρά των id αν το id είναι NULL.
+ */
+HT_ErrorCode FZ_PrintAllEntries(
+	int frozenDesc,		/* θέση στον πίνακα με τα ανοιχτά frozen αρχεία */
+	int *id			/* τιμή του πεδίου κλειδιού προς αναζήτηση */
+	);
+
+#endif // FROZEN_FILE_H
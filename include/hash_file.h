@@ -3,14 +3,54 @@
 
 #include <stdbool.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 typedef enum HT_ErrorCode {
   HT_OK,
   HT_ERROR
 } HT_ErrorCode;
 
-#define MAX_OPEN_FILES 20
+typedef enum GrowthMode {
+  EXTENDIBLE, // the directory doubles when a full bucket can not split
+  LINEAR      // one bucket splits at a time, in the order of the split pointer
+} GrowthMode;
+
+typedef enum MetricOp { // operations with a latency histogram
+  METRIC_INSERT, // HT_InsertEntry and HT_Upsert
+  METRIC_LOOKUP, // HT_PrintAllEntries with an id
+  METRIC_SCAN,   // HT_ScanPages and HT_PrintAllEntries without an id
+  METRIC_OPS
+} MetricOp;
+
+typedef enum RecordField { // fields of a Record that HT_UpdateFields changes, combined with |
+  FIELD_NAME = 1,
+  FIELD_SURNAME = 2,
+  FIELD_CITY = 4,
+  FIELD_ALL = FIELD_NAME | FIELD_SURNAME | FIELD_CITY
+} RecordField;
+
+#define HASH_MAGIC 0x58495448 // "HTIX", first field of the first block, files with an older layout lack it
+#define MAX_OPEN_FILES 64
 #define MAX_RECORDS 8 // meaning BF_BLOCK_SIZE / sizeof(Record)
-#define MAX_BUCKETS 64
+#define MAX_BUCKETS 128 // meaning BF_BLOCK_SIZE / sizeof(int), slots in a page of the directory
+#define MAX_DEPTH 31 // the directory can not double past this
+#define MAX_LOAD 80 // percent of the bucket space that linear hashing fills before a split
+#define MAX_SEGMENTS 25 // extents of the directory, enough for MAX_DEPTH
+#define EXTENT_BLOCKS 64 // blocks preallocated on disk at a time past the end of an index
+#define MAX_HANDLES 16 // BF_Block handles kept for reuse, more than any call pins at once
+#define MIN_LOAD 40 // percent of the bucket space under which linear hashing merges the last split back
+#define FREE_BLOCK -1 // localDepth of a block on the reuse list of the file
+#define MAX_FILE_NAME 256
+#define BLOOM_WORDS 8 // 64-bit words in a block of the Bloom filter, one cache line
+#define BLOOM_MIN_KEYS 1024 // the smallest filter is sized for this many ids
+#define LATENCY_STEPS 4 // buckets of a latency histogram in every power of two, a value is off by at most a quarter
+#define LATENCY_BUCKETS (40 * LATENCY_STEPS) // up to 2^40 ns, about 18 minutes
+#define SLOW_OPS 32 // slow operations kept, the oldest is overwritten
+#define SLOW_NS 1000000 // default threshold of a slow operation, 1 ms
+#define FLUSH_RUNS 64 // runs of a buffer flush between two chances of the caller to take the lock
+#define VALIDATE_BLOCKS 64 // blocks the check after an unclean close reads between two chances of the callers to take the lock
 
 typedef struct Record {
 	int id;
@@ -19,37 +59,123 @@ typedef struct Record {
 	char city[20];
 } Record;
 
-typedef struct Index{ // file information
-	int fileCount;
-	int fileDesc[MAX_OPEN_FILES];
-} Index;
-
 typedef struct Bucket{
   int recordCount;
   int localDepth;
   Record records[MAX_RECORDS]; 
+  int overflow; // next block of the bucket when linear hashing overflows it, -1 if none
 } Bucket;
 
-typedef struct HashTable{
-  int depth; 
+typedef struct HashInfo{ // first block of the file
+  int magic; // HASH_MAGIC
+  int depth; // global depth, or the round of linear hashing
+  int mode; // GrowthMode of the file
+  int splitPointer; // linear hashing, next bucket to split
+  int recordCount; // linear hashing, records in the file
+  int segments; // extents of the directory in use
+  int segment[MAX_SEGMENTS]; // first block of every extent, extent i > 0 has 2^(i-1) consecutive pages
+  int freeList; // first block of the reuse list, chained through overflow, -1 if empty
+  int freeBlocks; // blocks on the reuse list
+  int depthCount[MAX_DEPTH + 1]; // buckets of every local depth, the directory halves when none has the global one
+  int bloomBits; // bits per id of the Bloom filter kept next to the file, 0 for none
+} HashInfo;
+
+typedef struct BloomFilter{ // blocked Bloom filter over the ids of an open index, bits is NULL without one
+  unsigned long long *bits; // all the probes of an id fall in one block of BLOOM_WORDS words
+  int blockCount;
+  int probes;   // bits set for every id
+  int keys;     // ids added, a delete can not take its bits back
+  int capacity; // ids the filter was sized for, past them it is rebuilt twice as large
+  long negatives;      // lookups answered from memory
+  long falsePositives; // lookups that passed the filter and did not find the id
+} BloomFilter;
+
+typedef struct Index{ // file information
+	int fileCount;
+	int fileDesc[MAX_OPEN_FILES];
+	int osFile[MAX_OPEN_FILES]; // descriptor of the operating system used to preallocate
+	int extentBlocks[MAX_OPEN_FILES]; // blocks preallocated at a time, 0 for none
+	int reservedEnd[MAX_OPEN_FILES]; // the disk space is preallocated up to this block
+	HashInfo info[MAX_OPEN_FILES]; // copy of the first block, written through on every change
+	bool infoCached[MAX_OPEN_FILES];
+	char fileName[MAX_OPEN_FILES][MAX_FILE_NAME]; // the Bloom filter and the summary are saved next to it
+	BloomFilter bloom[MAX_OPEN_FILES];
+	long records[MAX_OPEN_FILES]; // extendible hashing, records in the file and its write buffer, -1 if not known
+	bool clean[MAX_OPEN_FILES]; // opened from the summary of a clean close
+} Index;
+
+typedef struct HashTable{ // a page of the directory, slot k is in page k / MAX_BUCKETS
   int buckets[MAX_BUCKETS];
-  int nextHT; // pointer to the next hashtable
 } HashTable;
 
-int hashFunction(int id, int depth); 
+typedef struct HT_Statistics{
+  int blocks;     // blocks of the file
+  int buckets;    // blocks that are buckets
+  int records;    // records in all the buckets
+  int minRecords; // records of the emptiest bucket
+  int maxRecords; // records of the fullest bucket
+  int reservedBlocks; // preallocated past the last block and not used yet
+  int freeBlocks; // emptied by deletes and waiting to be reused
+  int bloomBytes; // memory of the Bloom filter, 0 without one
+  int bloomKeys;  // ids added to the filter
+  double bloomFalsePositive; // expected fraction of missing ids the filter lets through
+  long bloomNegatives;      // lookups answered from memory since the file was opened
+  long bloomFalsePositives; // lookups that read the bucket and did not find the id
+} HT_Statistics;
+
+typedef struct HT_Summary{ // what is known about an open index without reading its buckets
+  int depth;       // global depth, or the round of linear hashing
+  int blocks;      // blocks of the file
+  int buckets;     // blocks that are buckets
+  long records;    // records in the file and its write buffer, -1 if not known yet
+  bool clean;      // opened from the summary of a clean close
+  int unvalidated; // blocks the check after an unclean close has not read yet
+  bool damaged;    // the check found a block that does not make sense
+} HT_Summary;
 
+typedef struct LatencyHistogram{ // log-linear like HDR, LATENCY_STEPS buckets in every power of two of ns
+  long count;
+  long totalNs;
+  long maxNs;
+  long buckets[LATENCY_BUCKETS];
+} LatencyHistogram;
 
-// a Linked List to be used for short-term purposes
-typedef struct LL {
-    int HTblock;
-    struct LL* next;
-} LL;
+typedef struct SlowOperation{ // an operation that took longer than the threshold
+  int op;        // MetricOp
+  int indexDesc;
+  int id;        // key of an insert or a lookup
+  int slot;      // slot of the directory it hashed to last, -1 for a scan
+  int depth;     // global depth at that point
+  int block;     // bucket block it went to last, -1 if none
+  int splits;    // what happened during the operation
+  int doublings;
+  int reinserts;
+  long ns;
+} SlowOperation;
+
+typedef struct HT_Metrics{ // of all the open files since HT_Init or HT_ResetMetrics
+  LatencyHistogram latency[METRIC_OPS];
+  long splits;     // buckets split, extendible and linear
+  long depthBumps; // splits of a full bucket that left all its records on one side, only the depth grew
+  long doublings;  // directory doublings
+  long reinserts;  // inserts tried again after a split or a doubling
+  long flushes;    // halves of write buffers written out
+  long slowThresholdNs;
+  long slowCount;  // slow operations seen, the last SLOW_OPS of them are in slow
+  SlowOperation slow[SLOW_OPS]; // ring buffer, slowCount % SLOW_OPS is overwritten next
+} HT_Metrics;
+
+int hashFunction(int id, int depth); 
 
-void insertLL(int hblock, LL** head);
+// the layout of the directory, shared by everything that reads the file without hash_file.c
+int slotOf(const HashInfo *info, int id); // the slot of the directory an id hashes to
+int pageBlock(const HashInfo *info, int slot); // the block of the directory page that holds a slot
 
-bool inLL(LL* head, int blocknum);
+// called by HT_Join for every pair of records with the same id, a from the first file and b from the second
+typedef void (*HT_JoinCallback)(const Record *a, const Record *b, void *ctx);
 
-void freeLL(LL* head);
+// called by HT_ScanPages with the records of one bucket page
+typedef void (*HT_PageCallback)(const Record *records, int count, void *ctx);
 
 
 /*
@@ -68,9 +194,22 @@ HT_ErrorCode HT_CreateIndex(
 	int depth
 	);
 
+/*
+ * Η συνάρτηση HT_CreateIndexMode είναι ίδια με την HT_CreateIndex, αλλά επιλέγει και τον τρόπο που μεγαλώνει το αρχείο.
+ * Με EXTENDIBLE ο κατάλογος διπλασιάζεται, ενώ με LINEAR σπάει ένα bucket τη φορά με τη σειρά του δείκτη διάσπασης,
+ * όταν οι εγγραφές ξεπεράσουν το MAX_LOAD τοις εκατό του χώρου των buckets.
+ * Σε περίπτωση που εκτελεστεί επιτυχώς επιστρέφεται HΤ_OK, ενώ σε διαφορετική περίπτωση κωδικός λάθους.
+ */
+HT_ErrorCode HT_CreateIndexMode(
+	const char *fileName,		/* όνομα αρχείου */
+	int depth,			/* αρχικό βάθος */
+	GrowthMode mode			/* EXTENDIBLE ή LINEAR */
+	);
+
 
 /*
- * Η ρουτίνα αυτή ανοίγει το αρχείο με όνομα fileName. 
+ * Η ρουτίνα αυτή ανοίγει το αρχείο με όνομα fileName. Ένα αρχείο που δεν ξεκινά με HASH_MAGIC, π.χ. παλιότερης
+ * μορφής, δεν ανοίγει.
  * Εάν το αρχείο ανοιχτεί κανονικά, η ρουτίνα επιστρέφει HT_OK, ενώ σε διαφορετική περίπτωση κωδικός λάθους.
  */
 HT_ErrorCode HT_OpenIndex(
@@ -78,9 +217,57 @@ HT_ErrorCode HT_OpenIndex(
   int *indexDesc            /* θέση στον πίνακα με τα ανοιχτά αρχεία  που επιστρέφεται */
 	);
 
+/*
+ * Η συνάρτηση HT_SetExtentSize ορίζει πόσα blocks δεσμεύονται στον δίσκο κάθε φορά (με fallocate) μετά το τέλος
+ * του ανοιχτού αρχείου indexDesc, ώστε τα νέα buckets και οι σελίδες του καταλόγου να είναι συνεχόμενα στον δίσκο.
+ * Τα blocks αυτά δεν μετράνε στην BF_GetBlockCounter και ό,τι δεν χρησιμοποιηθεί ελευθερώνεται στο HT_CloseFile.
+ * Με blocks 0 δεν γίνεται προδέσμευση. Η προεπιλογή είναι EXTENT_BLOCKS.
+ */
+HT_ErrorCode HT_SetExtentSize(
+	int indexDesc,		/* θέση στον πίνακα με τα ανοιχτά αρχεία */
+	int blocks		/* blocks ανά δέσμευση */
+	);
+
+/*
+ * Η συνάρτηση HT_SetBloomFilter δημιουργεί για το ανοιχτό αρχείο indexDesc ένα φίλτρο Bloom με bitsPerKey bits ανά id,
+ * χτισμένο από τις εγγραφές που υπάρχουν. Το φίλτρο ενημερώνεται σε κάθε εισαγωγή, αποθηκεύεται στο fileName.bloom
+ * στο HT_CloseFile και φορτώνεται στο HT_OpenIndex (αν λείπει, π.χ. μετά από κρασάρισμα, ξαναχτίζεται), ώστε οι
+ * αναζητήσεις id που δεν υπάρχουν να απαντώνται από τη μνήμη χωρίς να διαβαστεί κανένα bucket. Οι διαγραφές δεν
+ * αφαιρούν bits, μόνο αυξάνουν τα ψευδώς θετικά μέχρι το επόμενο ξαναχτίσιμο. Με bitsPerKey 0 το φίλτρο καταργείται.
+ * Σε περίπτωση που εκτελεστεί επιτυχώς επιστρέφεται HT_OK, ενώ σε διαφορετική περίπτωση κάποιος κωδικός λάθους.
+ */
+HT_ErrorCode HT_SetBloomFilter(
+	int indexDesc,		/* θέση στον πίνακα με τα ανοιχτά αρχεία */
+	int bitsPerKey		/* bits ανά id, 10 δίνει περίπου 1% ψευδώς θετικά */
+	);
+
+/*
+ * Η συνάρτηση HT_SetWriteBuffer δίνει στο ανοιχτό αρχείο indexDesc μια μνήμη εγγραφής δύο μισών με records εγγραφές
+ * το καθένα. Οι HT_InsertEntry γράφουν μόνο στη μνήμη, και όταν ένα μισό γεμίσει ένα νήμα το γράφει στο αρχείο
+ * ταξινομημένο κατά bucket, ενώ οι εισαγωγές συνεχίζουν στο άλλο. Οι αναζητήσεις id βλέπουν και τις εγγραφές της
+ * μνήμης. Οι HT_Upsert, HT_UpdateFields και HT_DeleteEntry αλλάζουν τις εγγραφές του id στη μνήμη χωρίς να την
+ * αδειάσουν, και στο αρχείο όταν το φίλτρο Bloom λέει ότι μπορεί να είναι κι εκεί, ενώ όσες συναρτήσεις διαβάζουν
+ * όλο το αρχείο την αδειάζουν πρώτα. Με records 0 η μνήμη αδειάζει και καταργείται, όπως και στο HT_CloseFile. Εγγραφές που δεν
+ * έχουν γραφτεί χάνονται σε κρασάρισμα.
+ * Σε περίπτωση που εκτελεστεί επιτυχώς επιστρέφεται HT_OK, ενώ σε διαφορετική περίπτωση κάποιος κωδικός λάθους.
+ */
+HT_ErrorCode HT_SetWriteBuffer(
+	int indexDesc,		/* θέση στον πίνακα με τα ανοιχτά αρχεία */
+	int records		/* εγγραφές κάθε μισού, 0 για καμία μνήμη */
+	);
+
+/*
+ * Η συνάρτηση HT_Flush γράφει στο αρχείο όλες τις εγγραφές της μνήμης εγγραφής του indexDesc.
+ * Σε περίπτωση που εκτελεστεί επιτυχώς επιστρέφεται HT_OK, ενώ σε διαφορετική περίπτωση κάποιος κωδικός λάθους.
+ */
+HT_ErrorCode HT_Flush(
+	int indexDesc		/* θέση στον πίνακα με τα ανοιχτά αρχεία */
+	);
+
 /*
  * Η ρουτίνα αυτή κλείνει το αρχείο του οποίου οι πληροφορίες βρίσκονται στην θέση indexDesc του πίνακα ανοιχτών αρχείων.
  * Επίσης σβήνει την καταχώρηση που αντιστοιχεί στο αρχείο αυτό στον πίνακα ανοιχτών αρχείων. 
+ * Δίπλα στο αρχείο γράφεται μια σύνοψη (βάθος, κατάλογος, εγγραφές, buckets) από την οποία ανοίγει την επόμενη φορά.
  * Η συνάρτηση επιστρέφει ΗΤ_OK εάν το αρχείο κλείσει επιτυχώς, ενώ σε διαφορετική σε περίπτωση κωδικός λάθους.
  */
 HT_ErrorCode HT_CloseFile(
@@ -96,6 +283,40 @@ HT_ErrorCode HT_InsertEntry(
 	int indexDesc,	/* θέση στον πίνακα με τα ανοιχτά αρχεία */
 	Record record		/* δομή που προσδιορίζει την εγγραφή */
 	);
+/*
+ * Η συνάρτηση HT_Upsert εισάγει την εγγραφή record αν το record.id δεν υπάρχει, αλλιώς αντικαθιστά επί τόπου τις
+ * εγγραφές με το ίδιο id, ώστε το αρχείο να μη γεμίζει με διπλότυπα. Η αναζήτηση και η αλλαγή γίνονται με ένα pin
+ * του bucket και μόνο ένα νέο id που δε χωράει στο bucket του περνάει από τη HT_InsertEntry.
+ * Σε περίπτωση που εκτελεστεί επιτυχώς επιστρέφεται HT_OK, ενώ σε διαφορετική περίπτωση κάποιος κωδικός λάθους.
+ */
+HT_ErrorCode HT_Upsert(
+	int indexDesc,	/* θέση στον πίνακα με τα ανοιχτά αρχεία */
+	Record record		/* δομή που προσδιορίζει την εγγραφή */
+	);
+
+/*
+ * Η συνάρτηση HT_UpdateFields αλλάζει επί τόπου μόνο τα πεδία fields (FIELD_NAME, FIELD_SURNAME, FIELD_CITY
+ * συνδυασμένα με |) των εγγραφών με record.id ίσο με id, παίρνοντας τις νέες τιμές από το values.
+ * Σε περίπτωση που εκτελεστεί επιτυχώς επιστρέφεται HT_OK, ενώ αν το id δεν υπάρχει ή σε άλλο λάθος κάποιος κωδικός λάθους.
+ */
+HT_ErrorCode HT_UpdateFields(
+	int indexDesc,	/* θέση στον πίνακα με τα ανοιχτά αρχεία */
+	int id,		/* τιμή του πεδίου κλειδιού */
+	int fields,		/* ποια πεδία αλλάζουν */
+	const Record *values	/* οι νέες τιμές, το values->id αγνοείται */
+	);
+
+/*
+ * Η συνάρτηση HT_DeleteEntry διαγράφει όλες τις εγγραφές με record.id ίσο με id από το αρχείο κατακερματισμού.
+ * Ένα bucket που αδειάζει αρκετά συγχωνεύεται με το buddy του και ο κατάλογος υποδιπλασιάζεται όταν κανένα bucket
+ * δεν έχει πια τοπικό βάθος ίσο με το ολικό. Τα blocks που ελευθερώνονται ξαναχρησιμοποιούνται από τις εισαγωγές
+ * και όσα μείνουν στο τέλος του αρχείου αποκόπτονται στο HT_CloseFile.
+ * Σε περίπτωση που εκτελεστεί επιτυχώς επιστρέφεται HT_OK, ενώ αν το id δεν υπάρχει ή σε άλλο λάθος κάποιος κωδικός λάθους.
+ */
+HT_ErrorCode HT_DeleteEntry(
+	int indexDesc,	/* θέση στον πίνακα με τα ανοιχτά αρχεία */
+	int id		/* τιμή του πεδίου κλειδιού προς διαγραφή */
+	);
 
 /*
  * Η συνάρτηση HΤ_PrintAllEntries χρησιμοποιείται για την εκτύπωση όλων των εγγραφών που το record.id έχει τιμή id. 
@@ -108,6 +329,115 @@ HT_ErrorCode HT_PrintAllEntries(
 	);
 
 
+/*
+ * Η συνάρτηση HT_Join καλεί την callback(a, b, ctx) για κάθε ζεύγος εγγραφών με το ίδιο id, την a από το αρχείο indexA
+ * και την b από το indexB. Και τα δύο αρχεία μοιράζουν τα id με τα ίδια χαμηλά bits της hashFunction, οπότε στο κοινό
+ * βάθος ενώνεται κάθε ομάδα slots χωριστά: τα buckets του αρχείου με το μικρότερο βάθος μπαίνουν σε έναν μικρό πίνακα
+ * κατακερματισμού στη μνήμη και τα buckets του άλλου τον ψάχνουν, ώστε κάθε σελίδα να διαβάζεται περίπου μία φορά.
+ * Οι εγγραφές ισχύουν μόνο κατά την κλήση και η callback δεν πρέπει να αλλάζει τα δύο αρχεία.
+ * Σε περίπτωση που εκτελεστεί επιτυχώς επιστρέφεται HT_OK, ενώ σε διαφορετική περίπτωση κάποιος κωδικός λάθους.
+ */
+HT_ErrorCode HT_Join(
+	int indexA,		/* θέση του πρώτου αρχείου στον πίνακα με τα ανοιχτά αρχεία */
+	int indexB,		/* θέση του δεύτερου αρχείου */
+	HT_JoinCallback callback,	/* καλείται για κάθε ζεύγος */
+	void *ctx		/* περνάει αμετάβλητο στην callback */
+	);
+
+/*
+ * Η συνάρτηση HT_ScanPages διαβάζει μία φορά κάθε σελίδα με εγγραφές του αρχείου, με τη σειρά των blocks, και
+ * καλεί την callback με τις εγγραφές της. Οι εγγραφές ισχύουν μόνο κατά την κλήση.
+ * Σε περίπτωση που εκτελεστεί επιτυχώς επιστρέφεται HT_OK, ενώ σε διαφορετική περίπτωση κάποιος κωδικός λάθους.
+ */
+HT_ErrorCode HT_ScanPages(
+	int indexDesc,	/* θέση στον πίνακα με τα ανοιχτά αρχεία */
+	HT_PageCallback callback,	/* καλείται για κάθε σελίδα */
+	void *ctx		/* περνάει αμετάβλητο στην callback */
+	);
+
+/*
+ * Η συνάρτηση HT_GetStatistics συμπληρώνει στη δομή stats τα στατιστικά (blocks, buckets, εγγραφές,
+ * ελάχιστες και μέγιστες εγγραφές ανά bucket) του ανοιχτού αρχείου στη θέση indexDesc.
+ * Σε περίπτωση που εκτελεστεί επιτυχώς επιστρέφεται HT_OK, ενώ σε διαφορετική περίπτωση κάποιος κωδικός λάθους.
+ */
+HT_ErrorCode HT_GetStatistics(
+	int indexDesc,	/* θέση στον πίνακα με τα ανοιχτά αρχεία */
+	HT_Statistics *stats	/* τα στατιστικά που επιστρέφονται */
+	);
+
+/*
+ * Η συνάρτηση HT_GetMetrics αντιγράφει στο metrics τα ιστογράμματα χρόνου των εισαγωγών, των αναζητήσεων και των
+ * σαρώσεων, τους μετρητές των διασπάσεων, των διπλασιασμών του καταλόγου και των επαναλαμβανόμενων εισαγωγών, και
+ * τις τελευταίες SLOW_OPS αργές λειτουργίες με το slot, το βάθος και το block τους.
+ */
+void HT_GetMetrics(
+	HT_Metrics *metrics	/* οι μετρήσεις που επιστρέφονται */
+	);
+
+/*
+ * Η συνάρτηση HT_ResetMetrics μηδενίζει όλες τις μετρήσεις, το όριο των αργών λειτουργιών μένει ίδιο.
+ */
+void HT_ResetMetrics();
+
+/*
+ * Η συνάρτηση HT_SetSlowThreshold ορίζει πόσα ns πρέπει να διαρκέσει μια λειτουργία για να κρατηθεί ως αργή.
+ * Η προεπιλογή είναι SLOW_NS.
+ */
+void HT_SetSlowThreshold(
+	long ns			/* όριο σε ns */
+	);
+
+/*
+ * Η συνάρτηση HT_LatencyPercentile επιστρέφει σε ns τον χρόνο κάτω από τον οποίο τελείωσε το fraction
+ * (από 0 έως 1) των λειτουργιών του histogram, με την ακρίβεια ενός bucket.
+ */
+long HT_LatencyPercentile(
+	const LatencyHistogram *histogram,	/* ένα από τα metrics.latency */
+	double fraction		/* π.χ. 0.99 */
+	);
+
+/*
+ * Η συνάρτηση HT_PrintMetrics εκτυπώνει τις μετρήσεις και τις αργές λειτουργίες, την πιο πρόσφατη πρώτη.
+ */
+void HT_PrintMetrics();
+
+/*
+ * Η συνάρτηση HT_Compact ξαναγράφει το ανοιχτό αρχείο indexDesc σε ένα νέο αρχείο: πρώτα το block πληροφοριών και
+ * ο κατάλογος σε συνεχόμενα blocks, μετά τα buckets με τη σειρά της πρώτης θέσης τους στον κατάλογο. Τα άδεια
+ * buckets αφαιρούνται, τα buddies που χωράνε σε ένα bucket συγχωνεύονται και ο κατάλογος μικραίνει όσο γίνεται, όπως
+ * στις διαγραφές. Στο linear hashing οι αλυσίδες απλώς πυκνώνουν. Το νέο αρχείο αντικαθιστά το παλιό με ένα rename
+ * και μένει ανοιχτό στην ίδια θέση indexDesc, οπότε οι σαρώσεις διαβάζουν σχεδόν σειριακά.
+ * Σε περίπτωση που εκτελεστεί επιτυχώς επιστρέφεται HT_OK, ενώ σε διαφορετική περίπτωση κάποιος κωδικός λάθους.
+ */
+HT_ErrorCode HT_Compact(
+	int indexDesc		/* θέση στον πίνακα με τα ανοιχτά αρχεία */
+	);
+
+/*
+ * Η συνάρτηση HT_GetSummary συμπληρώνει στο summary το βάθος, τα blocks, τα buckets και τις εγγραφές του ανοιχτού
+ * αρχείου indexDesc χωρίς να διαβάσει τα buckets του. Ένα αρχείο που έκλεισε κανονικά ανοίγει από τη σύνοψη που
+ * γράφτηκε στο κλείσιμο, με μία ανάγνωση. Μετά από κρασάρισμα ανοίγει αμέσως και ένα νήμα ελέγχει τα blocks του
+ * λίγα κάθε φορά, μετρώντας και τις εγγραφές, που είναι γνωστές όταν τελειώσει ο έλεγχος.
+ * Σε περίπτωση που εκτελεστεί επιτυχώς επιστρέφεται HT_OK, ενώ σε διαφορετική περίπτωση κάποιος κωδικός λάθους.
+ */
+HT_ErrorCode HT_GetSummary(
+	int indexDesc,		/* θέση στον πίνακα με τα ανοιχτά αρχεία */
+	HT_Summary *summary	/* η σύνοψη που επιστρέφεται */
+	);
+
+/*
+ * Η συνάρτηση HT_Validate τελειώνει τώρα τον έλεγχο του αρχείου indexDesc που ξεκίνησε στο άνοιγμα μετά από
+ * κρασάρισμα. Για αρχείο που έκλεισε κανονικά δεν κάνει τίποτα.
+ * Αν το αρχείο είναι σωστό επιστρέφεται HT_OK, ενώ αν κάποιο block του είναι χαλασμένο κωδικός λάθους.
+ */
+HT_ErrorCode HT_Validate(
+	int indexDesc		/* θέση στον πίνακα με τα ανοιχτά αρχεία */
+	);
+
 HT_ErrorCode HashStatistics(char* fileName);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif // HASH_FILE_H
\ No newline at end of file
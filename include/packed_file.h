@@ -0,0 +1,96 @@
+#ifndef PACKED_FILE_H
+#define PACKED_FILE_H
+
+#include "hash_file.h"
+
+#define PACKED_MAGIC 0x324b5048 // "HPK2", the page offsets are longs
+#define PACKED_DICT_MAX 16384 // strings in the dictionary, a code takes at most two bytes
+#define PACKED_PAGE_MAX 1024 // bytes of an encoded page, more than MAX_RECORDS records can take
+#define MAX_OPEN_PACKED 16
+
+typedef struct PackedHeader{ // start of a packed file
+  int magic;
+  int pageCount;   // bucket pages of the index, one slot each
+  int recordCount;
+  int dictCount;   // strings of the dictionary, code c > 0 is string c - 1
+  long dictOffset; // the dictionary, a length byte and the bytes of every string
+  long mapOffset;  // the page map, a PackedSlot for every page
+  long dataOffset; // the encoded pages, one after the other
+  long rawBytes;   // BF_BLOCK_SIZE for every page
+  long packedBytes; // bytes of all the encoded pages
+} PackedHeader;
+
+typedef struct PackedSlot{ // where an encoded page is, from dataOffset
+  long offset; // the encoded pages can pass 2 GiB
+  int length;
+} PackedSlot;
+
+typedef struct PackedString{
+  const unsigned char *bytes;
+  int length;
+} PackedString;
+
+typedef struct PackedFile{ // an open packed file, served from its mapping
+  const unsigned char *map;
+  long size;
+  const PackedHeader *header;
+  const PackedSlot *slots;
+  const unsigned char *data;
+  PackedString *dictionary;
+} PackedFile;
+
+/*
+ * Η συνάρτηση HT_Compress γράφει τις σελίδες με εγγραφές του ανοιχτού αρχείου indexDesc συμπιεσμένες σε ένα νέο
+ * αρχείο μόνο για ανάγνωση με όνομα outFile. Κάθε πεδίο συμβολοσειράς κόβεται στο τελευταίο μη μηδενικό byte (τα
+ * μηδενικά του γεμίσματος κωδικοποιούνται με το μήκος) ή γίνεται κωδικός ενός λεξικού με τις συμβολοσειρές που
+ * επαναλαμβάνονται, και τα id γράφονται ως διαφορές μεταβλητού μήκους. Οι σελίδες έχουν μεταβλητό μέγεθος και
+ * βρίσκονται μέσω ενός πίνακα σελίδων.
+ * Σε περίπτωση που εκτελεστεί επιτυχώς επιστρέφεται HT_OK, ενώ σε διαφορετική περίπτωση κάποιος κωδικός λάθους.
+ */
+HT_ErrorCode HT_Compress(
+	int indexDesc,		/* θέση στον πίνακα με τα ανοιχτά αρχεία */
+	const char *outFile	/* όνομα του νέου αρχείου */
+	);
+
+/*
+ * Η ρουτίνα αυτή ανοίγει ένα αρχείο που έγραψε η HT_Compress απεικονίζοντάς το στη μνήμη (mmap).
+ * Εάν το αρχείο ανοιχτεί κανονικά, η ρουτίνα επιστρέφει HT_OK, ενώ σε διαφορετική περίπτωση κωδικός λάθους.
+ */
+HT_ErrorCode PK_OpenIndex(
+	const char *fileName,	/* όνομα αρχείου */
+	int *packedDesc		/* θέση στον πίνακα με τα ανοιχτά packed αρχεία που επιστρέφεται */
+	);
+
+/*
+ * Η ρουτίνα αυτή κλείνει το packed αρχείο στη θέση packedDesc.
+ */
+HT_ErrorCode PK_CloseFile(
+	int packedDesc		/* θέση στον πίνακα με τα ανοιχτά packed αρχεία */
+	);
+
+/*
+ * Η συνάρτηση PK_ReadPage αποσυμπιέζει τη σελίδα page στο records, που έχει χώρο για MAX_RECORDS εγγραφές,
+ * και επιστρέφει στο count πόσες εγγραφές έχει.
+ * Σε περίπτωση που εκτελεστεί επιτυχώς επιστρέφεται HT_OK, ενώ σε διαφορετική περίπτωση κάποιος κωδικός λάθους.
+ */
+HT_ErrorCode PK_ReadPage(
+	int packedDesc,		/* θέση στον πίνακα με τα ανοιχτά packed αρχεία */
+	int page,		/* από 0 έως pageCount - 1 */
+	Record *records,	/* οι εγγραφές που επιστρέφονται */
+	int *count		/* πλήθος εγγραφών της σελίδας */
+	);
+
+/*
+ * Η συνάρτηση PK_ScanPages αποσυμπιέζει με τη σειρά κάθε σελίδα και καλεί την callback με τις εγγραφές της,
+ * όπως η HT_ScanPages. Οι εγγραφές ισχύουν μόνο κατά την κλήση.
+ * Σε περίπτωση που εκτελεστεί επιτυχώς επιστρέφεται HT_OK, ενώ σε διαφορετική περίπτωση κάποιος κωδικός λάθους.
+ */
+HT_ErrorCode PK_ScanPages(
+	int packedDesc,		/* θέση στον πίνακα με τα ανοιχτά packed αρχεία */
+	HT_PageCallback callback,	/* καλείται για κάθε σελίδα */
+	void *ctx		/* περνάει αμετάβλητο στην callback */
+	);
+
+HT_ErrorCode PackedStatistics(char *fileName);
+
+#endif // PACKED_FILE_H
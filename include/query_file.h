@@ -0,0 +1,92 @@
+#ifndef QUERY_FILE_H
+#define QUERY_FILE_H
+
+#include "hash_file.h"
+
+#define MAX_PREDICATES 8
+#define QUERY_BATCH 256 // records filtered together, the records of 32 full pages
+#define MAX_KEY 20 // the longest string field of a Record
+
+typedef enum Column {
+  COLUMN_NONE = -1,
+  COLUMN_ID,
+  COLUMN_NAME,
+  COLUMN_SURNAME,
+  COLUMN_CITY
+} Column;
+
+typedef enum PredicateOp {
+  PRED_EQUALS,   // the field is the value
+  PRED_PREFIX,   // the field starts with the value
+  PRED_CONTAINS  // the value is somewhere in the field
+} PredicateOp;
+
+typedef struct Predicate{ // a filter on a string field
+  Column column;
+  PredicateOp op;
+  char value[MAX_KEY + 1];
+} Predicate;
+
+typedef struct Query{
+  int minId; // only records with minId <= id <= maxId
+  int maxId;
+  int predicateCount;
+  Predicate predicates[MAX_PREDICATES]; // all of them must hold
+  int projection; // RecordField mask of the string fields kept in the rows, the id is always kept
+  Column groupBy; // COLUMN_NONE returns the rows, otherwise one group per value of the column
+} Query;
+
+typedef struct QueryGroup{
+  char key[MAX_KEY + 1]; // value of the group by column, empty without group by
+  int count;
+  int minId;
+  int maxId;
+} QueryGroup;
+
+typedef struct QueryResult{
+  Record *rows;     // the records that passed, without group by
+  int rowCount;
+  QueryGroup *groups; // the groups in order of first appearance, one for all the rows without group by
+  int groupCount;
+  int scanned;      // records read
+} QueryResult;
+
+/*
+ * Η συνάρτηση QR_InitQuery αρχικοποιεί ένα ερώτημα που επιστρέφει όλες τις εγγραφές με όλα τα πεδία.
+ */
+void QR_InitQuery(
+	Query *query		/* το ερώτημα */
+	);
+
+/*
+ * Η συνάρτηση QR_AddPredicate προσθέτει στο ερώτημα το φίλτρο column op value σε πεδίο συμβολοσειράς.
+ * Επιστρέφει HT_ERROR αν το ερώτημα έχει ήδη MAX_PREDICATES φίλτρα ή το πεδίο δεν είναι συμβολοσειρά.
+ */
+HT_ErrorCode QR_AddPredicate(
+	Query *query,		/* το ερώτημα */
+	Column column,		/* COLUMN_NAME, COLUMN_SURNAME ή COLUMN_CITY */
+	PredicateOp op,		/* είδος σύγκρισης */
+	const char *value	/* τιμή σύγκρισης */
+	);
+
+/*
+ * Η συνάρτηση QR_Run εκτελεί το ερώτημα διαβάζοντας μία φορά τις σελίδες του ανοιχτού αρχείου indexDesc.
+ * Οι εγγραφές φιλτράρονται ανά QUERY_BATCH, πρώτα με το εύρος των id και μετά με τα φίλτρα των πεδίων, και
+ * είτε αντιγράφονται στο result->rows με τα πεδία της projection είτε αθροίζονται στις ομάδες (πλήθος, ελάχιστο
+ * και μέγιστο id). Το result ελευθερώνεται με την QR_FreeResult.
+ * Σε περίπτωση που εκτελεστεί επιτυχώς επιστρέφεται HT_OK, ενώ σε διαφορετική περίπτωση κάποιος κωδικός λάθους.
+ */
+HT_ErrorCode QR_Run(
+	int indexDesc,		/* θέση στον πίνακα με τα ανοιχτά αρχεία */
+	const Query *query,	/* το ερώτημα */
+	QueryResult *result	/* το αποτέλεσμα που επιστρέφεται */
+	);
+
+/*
+ * Η συνάρτηση QR_FreeResult ελευθερώνει τη μνήμη ενός αποτελέσματος της QR_Run.
+ */
+void QR_FreeResult(
+	QueryResult *result	/* το αποτέλεσμα */
+	);
+
+#endif // QUERY_FILE_H
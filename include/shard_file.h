@@ -0,0 +1,90 @@
+#ifndef SHARD_FILE_H
+#define SHARD_FILE_H
+
+#include "hash_file.h"
+
+#define MAX_SHARDS 16
+#define MAX_OPEN_SHARDED 4
+
+typedef struct ShardInfo{ // first block of the sharded index file
+  int shardCount;
+  int depth;
+} ShardInfo;
+
+typedef struct ShardedIndex{ // sharded file information
+  int shardCount;
+  int indexDesc[MAX_SHARDS]; // where every shard is in the open files of the hash layer
+} ShardedIndex;
+
+/*
+ * Η συνάρτηση shardFunction επιστρέφει σε ποιο από τα shardCount αρχεία ανήκει η εγγραφή με κλειδί id.
+ * Χρησιμοποιεί τα ανώτερα bits ενός πολλαπλασιαστικού κατακερματισμού, ώστε να μην επηρεάζει τα
+ * χαμηλά bits που χρησιμοποιεί η hashFunction μέσα σε κάθε αρχείο.
+ */
+int shardFunction(int id, int shardCount);
+
+/*
+ * Η συνάρτηση SH_CreateIndex δημιουργεί ένα αρχείο κατακερματισμού με όνομα fileName που μοιράζεται σε shardCount αρχεία
+ * (fileName.0, fileName.1, ...) με αρχικό βάθος depth. Στο ίδιο το fileName κρατιέται μόνο ο αριθμός των shards.
+ * Σε περίπτωση που εκτελεστεί επιτυχώς επιστρέφεται HT_OK, ενώ σε διαφορετική περίπτωση κωδικός λάθους.
+ */
+HT_ErrorCode SH_CreateIndex(
+	const char *fileName,	/* όνομα αρχείου */
+	int depth,		/* αρχικό βάθος κάθε shard */
+	int shardCount		/* αριθμός των shards */
+	);
+
+/*
+ * Η ρουτίνα αυτή ανοίγει το αρχείο fileName και όλα τα shards του.
+ * Εάν ανοιχτούν κανονικά, η ρουτίνα επιστρέφει HT_OK, ενώ σε διαφορετική περίπτωση κωδικός λάθους.
+ */
+HT_ErrorCode SH_OpenIndex(
+	const char *fileName,	/* όνομα αρχείου */
+	int *shardDesc		/* θέση στον πίνακα με τα ανοιχτά sharded αρχεία που επιστρέφεται */
+	);
+
+/*
+ * Η ρουτίνα αυτή κλείνει όλα τα shards του αρχείου στη θέση shardDesc και σβήνει την καταχώρησή του.
+ */
+HT_ErrorCode SH_CloseFile(
+	int shardDesc		/* θέση στον πίνακα με τα ανοιχτά sharded αρχεία */
+	);
+
+/*
+ * Η συνάρτηση SH_InsertEntry εισάγει την εγγραφή κατευθείαν στο shard που της αντιστοιχεί.
+ */
+HT_ErrorCode SH_InsertEntry(
+	int shardDesc,		/* θέση στον πίνακα με τα ανοιχτά sharded αρχεία */
+	Record record		/* δομή που προσδιορίζει την εγγραφή */
+	);
+
+/*
+ * Η συνάρτηση SH_InsertEntries εισάγει count εγγραφές. Οι εγγραφές ομαδοποιούνται πρώτα ανά shard,
+ * ώστε κάθε shard να φορτώνεται (και να διπλασιάζεται) ξεχωριστά από τα υπόλοιπα.
+ */
+HT_ErrorCode SH_InsertEntries(
+	int shardDesc,		/* θέση στον πίνακα με τα ανοιχτά sharded αρχεία */
+	const Record *records,	/* οι εγγραφές προς εισαγωγή */
+	int count		/* πλήθος εγγραφών */
+	);
+
+/*
+ * Η συνάρτηση SH_PrintAllEntries εκτυπώνει τις εγγραφές με κλειδί id ψάχνοντας μόνο στο shard τους.
+ * Αν το id είναι NULL εκτυπώνει τις εγγραφές όλων των shards.
+ */
+HT_ErrorCode SH_PrintAllEntries(
+	int shardDesc,		/* θέση στον πίνακα με τα ανοιχτά sharded αρχεία */
+	int *id			/* τιμή του πεδίου κλειδιού προς αναζήτηση */
+	);
+
+/*
+ * Η συνάρτηση SH_GetStatistics αθροίζει τα στατιστικά όλων των shards στη δομή stats.
+ */
+HT_ErrorCode SH_GetStatistics(
+	int shardDesc,		/* θέση στον πίνακα με τα ανοιχτά sharded αρχεία */
+	HT_Statistics *stats	/* τα στατιστικά που επιστρέφονται */
+	);
+
+HT_ErrorCode ShardStatistics(char* fileName);
+
+#endif // SHARD_FILE_H
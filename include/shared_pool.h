@@ -0,0 +1,129 @@
+#ifndef SHARED_POOL_H
+#define SHARED_POOL_H
+
+#include <pthread.h>
+#include "bf.h"
+#include "hash_file.h"
+
+#define SHARED_MAGIC 0x50534854 // "THSP"
+#define SHARED_TABLE_LOAD 2 // chains of the page table for every frame
+#define MAX_OPEN_SHARED 16
+#define SHARED_PINNERS 64 // processes that can pin pages at the same time
+#define SHARED_PIN_TRIES 1000 // waits for a frame while all are pinned before a lookup fails
+
+typedef enum FrameState{
+  FRAME_FREE,    // holds no page
+  FRAME_LOADING, // the one process that claimed it is reading the page in, the others wait
+  FRAME_VALID
+} FrameState;
+
+typedef struct SharedFrame{ // a page of a hash file in the segment
+  unsigned long long file; // identity of the file, see SharedFile
+  int block;
+  int next;       // next frame in the chain of the page table, -1 at the end
+  int state;      // FrameState, changed atomically
+  int pins;       // readers copying out of it now, changed atomically, only pinned under the lock,
+                  // each one also in the SharedPinner of its process
+  int referenced; // clock bit, set on every hit
+  int loader;     // pid of the process reading the page in
+  char data[BF_BLOCK_SIZE];
+} SharedFrame;
+
+typedef struct SharedPinner{ // a process that pins pages, it pins one at a time
+  int pid;        // 0 when free, a dead one is taken over with its pin
+  int frame;      // the frame it pins now, -1 if none, exchanged atomically by whoever drops the pin
+} SharedPinner;
+
+typedef struct SharedHeader{ // start of the segment, the page table and the frames follow it
+  int magic;      // set last by the process that creates the segment
+  int frames;
+  int tableSize;  // chains of the page table, a power of two
+  int hand;       // clock hand of the eviction
+  pthread_mutex_t lock; // process shared and robust, guards the page table and the hand
+  long hits;
+  long misses;
+  long waits;     // lookups that found the page being read in by another process
+  long evictions;
+  SharedPinner pinners[SHARED_PINNERS]; // guarded by the lock, except the frame of a live one
+} SharedHeader;
+
+typedef struct SharedFile{ // a hash file opened for reading through the pool
+  int fd;
+  unsigned long long file; // device, inode and modification time, a file replaced by rename gets new pages
+  int blocks;
+  HashInfo info;
+} SharedFile;
+
+/*
+ * Η ρουτίνα SP_Attach συνδέει τη διεργασία με το τμήμα κοινής μνήμης poolName (π.χ. "/ht_pool"), που κρατά frames
+ * σελίδες. Η πρώτη διεργασία του μηχανήματος το δημιουργεί, οι επόμενες το βρίσκουν ήδη ζεστό. Όλες οι διεργασίες που
+ * ανοίγουν αρχεία με τη SP_OpenIndex μοιράζονται έτσι μία μνήμη σελίδων αντί για μία ανά διεργασία. Κάθε σελίδα τη
+ * διαβάζει από το δίσκο μία μόνο διεργασία, οι υπόλοιπες την περιμένουν, και μια σελίδα δεν αντικαθίσταται όσο
+ * κάποια διεργασία την καρφιτσώνει. Η καρφίτσα μιας διεργασίας που πέθανε επιστρέφεται από τις υπόλοιπες, και μια
+ * αναζήτηση που βρίσκει όλες τις σελίδες καρφιτσωμένες για πολύ αποτυγχάνει αντί να περιμένει για πάντα.
+ * Σε περίπτωση που εκτελεστεί επιτυχώς επιστρέφεται HT_OK, ενώ σε διαφορετική περίπτωση κάποιος κωδικός λάθους.
+ */
+HT_ErrorCode SP_Attach(
+	const char *poolName,	/* όνομα του τμήματος κοινής μνήμης */
+	int frames		/* σελίδες του τμήματος, αν το δημιουργήσει αυτή η διεργασία */
+	);
+
+/*
+ * Η ρουτίνα SP_Detach αποσυνδέει τη διεργασία από το τμήμα. Με remove το τμήμα σβήνεται και από το σύστημα,
+ * αφού αποσυνδεθούν και οι υπόλοιπες διεργασίες.
+ */
+HT_ErrorCode SP_Detach(
+	bool remove		/* σβήσιμο του τμήματος */
+	);
+
+/*
+ * Η ρουτίνα αυτή ανοίγει μόνο για ανάγνωση ένα αρχείο κατακερματισμού, που διαβάζεται στο εξής μέσω του τμήματος
+ * κοινής μνήμης και όχι του επιπέδου BF. Το αρχείο δεν πρέπει να αλλάζει όσο είναι ανοιχτό με αυτόν τον τρόπο:
+ * το τμήμα διαβάζει το αρχείο απευθείας από το δίσκο και δεν προστατεύεται από μια ταυτόχρονη HT_InsertEntry ή
+ * άλλη αλλαγή, ούτε βλέπει όσα κρατά ακόμα η μνήμη του επιπέδου BF. Ισχύει λοιπόν ο κανόνας του ενός εγγραφέα:
+ * το αρχείο το γράφει μία διεργασία, που το κλείνει με την HT_CloseFile πριν το ανοίξουν οι αναγνώστες, και
+ * μια νέα έκδοσή του γράφεται σε άλλο αρχείο που αντικαθιστά το παλιό με rename, οπότε ανοίγεται ξανά και
+ * παίρνει νέες σελίδες.
+ * Εάν το αρχείο ανοιχτεί κανονικά, η ρουτίνα επιστρέφει HT_OK, ενώ σε διαφορετική περίπτωση κωδικός λάθους.
+ */
+HT_ErrorCode SP_OpenIndex(
+	const char *fileName,	/* όνομα αρχείου */
+	int *sharedDesc		/* θέση στον πίνακα με τα ανοιχτά αρχεία της κοινής μνήμης που επιστρέφεται */
+	);
+
+/*
+ * Η ρουτίνα αυτή κλείνει το αρχείο στη θέση sharedDesc. Οι σελίδες του μένουν στο τμήμα για τις άλλες διεργασίες.
+ */
+HT_ErrorCode SP_CloseFile(
+	int sharedDesc		/* θέση στον πίνακα με τα ανοιχτά αρχεία της κοινής μνήμης */
+	);
+
+/*
+ * Η συνάρτηση SP_Lookup γράφει στο records έως capacity εγγραφές με το id και επιστρέφει στο count πόσες υπάρχουν,
+ * διαβάζοντας τον κατάλογο και το bucket από το τμήμα κοινής μνήμης.
+ * Σε περίπτωση που εκτελεστεί επιτυχώς επιστρέφεται HT_OK, ενώ σε διαφορετική περίπτωση κάποιος κωδικός λάθους.
+ */
+HT_ErrorCode SP_Lookup(
+	int sharedDesc,		/* θέση στον πίνακα με τα ανοιχτά αρχεία της κοινής μνήμης */
+	int id,			/* το id που αναζητείται */
+	Record *records,	/* οι εγγραφές που επιστρέφονται */
+	int capacity,		/* χώρος του records */
+	int *count		/* πλήθος εγγραφών με το id */
+	);
+
+/*
+ * Η συνάρτηση SP_PrintAllEntries εκτυπώνει τις εγγραφές με το id, όπως η HT_PrintAllEntries.
+ * Σε περίπτωση που εκτελεστεί επιτυχώς επιστρέφεται HT_OK, ενώ σε διαφορετική περίπτωση κάποιος κωδικός λάθους.
+ */
+HT_ErrorCode SP_PrintAllEntries(
+	int sharedDesc,		/* θέση στον πίνακα με τα ανοιχτά αρχεία της κοινής μνήμης */
+	int *id			/* τιμή του πεδίου κλειδιού προς αναζήτηση */
+	);
+
+/*
+ * Η συνάρτηση SharedStatistics εκτυπώνει το μέγεθος του τμήματος και τις επιτυχίες, αποτυχίες και αντικαταστάσεις
+ * σελίδων όλων των διεργασιών.
+ */
+HT_ErrorCode SharedStatistics();
+
+#endif // SHARED_POOL_H
@@ -0,0 +1,252 @@
+#include "frozen_file.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static FrozenFile frozenTable[MAX_OPEN_FROZEN]; // open frozen files, map NULL when free
+
+typedef struct Gather{ // the records of an index collected by HT_Freeze
+  Record *records;
+  int count;
+  int capacity;
+  bool failed;
+} Gather;
+
+static void gatherPage(const Record *records, int count, void *ctx)
+{
+  Gather *gather = ctx;
+  if (gather->failed)
+    return;
+  if (gather->count + count > gather->capacity) {
+    int capacity = gather->capacity == 0 ? 1024 : gather->capacity * 2;
+    Record *grown = realloc(gather->records, capacity * sizeof(Record));
+    if (grown == NULL) {
+      gather->failed = true;
+      return;
+    }
+    gather->records = grown;
+    gather->capacity = capacity;
+  }
+  memcpy(&gather->records[gather->count], records, count * sizeof(Record));
+  gather->count += count;
+}
+
+static int compareIds(const void *a, const void *b)
+{
+  int x = ((const Record *)a)->id, y = ((const Record *)b)->id;
+  return (x > y) - (x < y);
+}
+
+static int pagesFor(long bytes)
+{
+  return (bytes + FROZEN_PAGE_SIZE - 1) / FROZEN_PAGE_SIZE;
+}
+
+// write count bytes and pad them with zeros to whole pages
+static bool writePages(int fd, const void *data, long count)
+{
+  static const char zeros[FROZEN_PAGE_SIZE];
+  for (long written = 0; written < count;) {
+    ssize_t n = write(fd, (const char *)data + written, count - written);
+    if (n <= 0)
+      return false;
+    written += n;
+  }
+  long padding = (long)pagesFor(count) * FROZEN_PAGE_SIZE - count;
+  return padding == 0 || write(fd, zeros, padding) == padding;
+}
+
+HT_ErrorCode HT_Freeze(int indexDesc, const char *outFile)
+{
+  Gather gather = { NULL, 0, 0, false };
+  if (HT_ScanPages(indexDesc, gatherPage, &gather) != HT_OK || gather.failed) {
+    free(gather.records);
+    return HT_ERROR;
+  }
+  qsort(gather.records, gather.count, sizeof(Record), compareIds);
+
+  FrozenHeader header;
+  memset(&header, 0, sizeof(FrozenHeader));
+  header.magic = FROZEN_MAGIC;
+  header.recordCount = gather.count;
+  header.pageCount = (gather.count + FROZEN_RECORDS - 1) / FROZEN_RECORDS;
+  header.fencePage = 1;
+  header.dataPage = header.fencePage + pagesFor((long)header.pageCount * sizeof(int));
+  header.minId = gather.count == 0 ? 0 : gather.records[0].id;
+  header.maxId = gather.count == 0 ? 0 : gather.records[gather.count - 1].id;
+  int *fences = malloc((header.pageCount + 1) * sizeof(int));
+  if (fences == NULL) {
+    free(gather.records);
+    return HT_ERROR;
+  }
+  for (int p = 0; p < header.pageCount; p++)
+    fences[p] = gather.records[p * FROZEN_RECORDS].id;
+
+  // written next to the target and renamed over it, a reader never sees half a file
+  char tmpName[512];
+  snprintf(tmpName, sizeof(tmpName), "%s.tmp", outFile);
+  int fd = open(tmpName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  bool ok = fd != -1 && writePages(fd, &header, sizeof(FrozenHeader)) &&
+            writePages(fd, fences, (long)header.pageCount * sizeof(int));
+  for (int p = 0; ok && p < header.pageCount; p++) {
+    int count = gather.count - p * FROZEN_RECORDS < FROZEN_RECORDS ? gather.count - p * FROZEN_RECORDS : FROZEN_RECORDS;
+    ok = writePages(fd, &gather.records[p * FROZEN_RECORDS], (long)count * sizeof(Record));
+  }
+  ok = ok && fsync(fd) == 0;
+  if (fd != -1)
+    ok = close(fd) == 0 && ok;
+  ok = ok && rename(tmpName, outFile) == 0;
+  if (!ok)
+    unlink(tmpName);
+  free(fences);
+  free(gather.records);
+  return ok ? HT_OK : HT_ERROR;
+}
+
+HT_ErrorCode FZ_OpenIndex(const char *fileName, int *frozenDesc)
+{
+  int slot = -1;
+  for (int i = 0; i < MAX_OPEN_FROZEN && slot == -1; i++) {
+    if (frozenTable[i].map == NULL)
+      slot = i;
+  }
+  if (slot == -1)
+    return HT_ERROR;
+
+  int fd = open(fileName, O_RDONLY);
+  struct stat st;
+  if (fd == -1)
+    return HT_ERROR;
+  if (fstat(fd, &st) != 0 || st.st_size < FROZEN_PAGE_SIZE) {
+    close(fd);
+    return HT_ERROR;
+  }
+  const char *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd); // the mapping keeps the file
+  if (map == MAP_FAILED)
+    return HT_ERROR;
+
+  const FrozenHeader *header = (const FrozenHeader *)map;
+  if (header->magic != FROZEN_MAGIC ||
+      (long)(header->dataPage + header->pageCount) * FROZEN_PAGE_SIZE > st.st_size) {
+    munmap((void *)map, st.st_size);
+    return HT_ERROR;
+  }
+  madvise((void *)map, st.st_size, MADV_RANDOM); // lookups touch single pages
+  FrozenFile *file = &frozenTable[slot];
+  file->map = map;
+  file->size = st.st_size;
+  file->header = header;
+  file->fences = (const int *)(map + (long)header->fencePage * FROZEN_PAGE_SIZE);
+  file->records = (const Record *)(map + (long)header->dataPage * FROZEN_PAGE_SIZE);
+  *frozenDesc = slot;
+  return HT_OK;
+}
+
+HT_ErrorCode FZ_CloseFile(int frozenDesc)
+{
+  if (frozenDesc < 0 || frozenDesc >= MAX_OPEN_FROZEN || frozenTable[frozenDesc].map == NULL)
+    return HT_ERROR;
+  munmap((void *)frozenTable[frozenDesc].map, frozenTable[frozenDesc].size);
+  memset(&frozenTable[frozenDesc], 0, sizeof(FrozenFile));
+  return HT_OK;
+}
+
+// the records of a page, they are FROZEN_PAGE_SIZE apart in the mapping
+static const Record *pageRecords(const FrozenFile *file, int page, int *count)
+{
+  int left = file->header->recordCount - page * FROZEN_RECORDS;
+  *count = left < FROZEN_RECORDS ? left : FROZEN_RECORDS;
+  return (const Record *)((const char *)file->records + (long)page * FROZEN_PAGE_SIZE);
+}
+
+// interpolation search on the fences for the last page whose first id is not after id, -1 if none
+static int findPage(const FrozenFile *file, int id)
+{
+  const int *fences = file->fences;
+  int low = 0, high = file->header->pageCount - 1;
+  if (high < 0 || id < fences[0])
+    return -1;
+  if (fences[high] <= id)
+    return high;
+  // fences[low] <= id < fences[high]
+  while (high - low > 1) {
+    long long guess = low + (long long)(id - (long long)fences[low]) * (high - low) / ((long long)fences[high] - fences[low]);
+    int page = guess <= low ? low + 1 : guess >= high ? high - 1 : (int)guess;
+    if (fences[page] <= id)
+      low = page;
+    else
+      high = page;
+  }
+  return low;
+}
+
+HT_ErrorCode FZ_Lookup(int frozenDesc, int id, Record *records, int capacity, int *count)
+{
+  if (frozenDesc < 0 || frozenDesc >= MAX_OPEN_FROZEN || frozenTable[frozenDesc].map == NULL)
+    return HT_ERROR;
+  const FrozenFile *file = &frozenTable[frozenDesc];
+  *count = 0;
+  int page = findPage(file, id);
+  if (page == -1 || id > file->header->maxId)
+    return HT_OK;
+  while (page > 0 && file->fences[page] == id) // duplicates may start on the page before
+    page--;
+
+  for (; page < file->header->pageCount; page++) {
+    int pageCount;
+    const Record *pageRecord = pageRecords(file, page, &pageCount);
+    int low = 0, high = pageCount; // first record with an id not before id
+    while (low < high) {
+      int middle = (low + high) / 2;
+      if (pageRecord[middle].id < id)
+        low = middle + 1;
+      else
+        high = middle;
+    }
+    for (int i = low; i < pageCount && pageRecord[i].id == id; i++) {
+      if (*count < capacity)
+        records[*count] = pageRecord[i];
+      *count += 1;
+    }
+    if (pageRecord[pageCount - 1].id > id)
+      break; // the next page starts after id
+  }
+  return HT_OK;
+}
+
+static void printRecord(const Record *r)
+{
+  printf("ID: %d, name: %.*s, surname: %.*s, city: %.*s\n", r->id, (int)sizeof(r->name), r->name,
+         (int)sizeof(r->surname), r->surname, (int)sizeof(r->city), r->city);
+}
+
+HT_ErrorCode FZ_PrintAllEntries(int frozenDesc, int *id)
+{
+  if (frozenDesc < 0 || frozenDesc >= MAX_OPEN_FROZEN || frozenTable[frozenDesc].map == NULL)
+    return HT_ERROR;
+  const FrozenFile *file = &frozenTable[frozenDesc];
+  if (id == NULL) {
+    for (int page = 0; page < file->header->pageCount; page++) {
+      int count;
+      const Record *records = pageRecords(file, page, &count);
+      for (int i = 0; i < count; i++)
+        printRecord(&records[i]);
+    }
+    return HT_OK;
+  }
+
+  Record records[FROZEN_RECORDS];
+  int count;
+  if (FZ_Lookup(frozenDesc, *id, records, FROZEN_RECORDS, &count) != HT_OK)
+    return HT_ERROR;
+  if (count == 0)
+    printf("ID doesn't exist\n");
+  for (int i = 0; i < count && i < FROZEN_RECORDS; i++)
+    printRecord(&records[i]);
+  return HT_OK;
+}
@@ -1,9 +1,17 @@
+#define _GNU_SOURCE // fallocate
 #include "hash_file.h"
 #include "bf.h"
+#include <fcntl.h>
 #include <math.h> 
+#include <pthread.h>
+#include <sched.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
 
 #define CALL_BF(call)             \
     {                             \
@@ -15,37 +23,287 @@
     }
 
 static Index indexTable; // index table for the open files
+static BF_Block* handlePool[MAX_HANDLES]; // block handles kept between calls instead of freed
+static int handleCount;
+static BF_Block* pinnedHandles[MAX_HANDLES]; // handles that hold a pin right now
+static int pinnedCount;
 
+typedef enum UpdateResult {
+    NOT_FOUND,
+    UPDATED,  // the record with the same id was changed in place
+    APPENDED  // a new id that fit in its bucket
+} UpdateResult;
 
-// the Linked List Functions
-void insertLL(int hblock, LL** head)
+typedef struct Chain { // the blocks and records of a bucket chain, the arrays only grow and are reused
+    int* blocks;
+    int blockCount;
+    int blockCapacity;
+    Record* records;
+    int recordCount;
+    int recordCapacity;
+    int localDepth;
+} Chain;
+
+static Chain chainBuffer; // linear hashing rewrites one chain at a time
+
+typedef struct WriteBuffer{ // inserts of an index kept in memory, one half fills while the other is written out
+    Record* records[2];
+    int count[2];
+    int capacity; // records of a half
+    int active;   // the half that takes inserts
+    bool flushing; // the other half is being written out
+    bool sorted;   // and its records are in slot order
+    unsigned sortMask; // the low bits of the ids it is sorted by
+    int flushed;   // records of the other half already in the file
+    int* table;    // the records of the active half by id, open addressing with linear probing
+    unsigned tableMask; // entries of the table minus one, at least twice the records of a half
+    int indexDesc;
+    bool stop;     // the index was closed, the flusher thread frees the buffer and exits
+    HT_ErrorCode error; // of the flusher thread, returned by the next insert
+    pthread_cond_t wake;
+} WriteBuffer;
+
+static WriteBuffer* writeBuffers[MAX_OPEN_FILES]; // NULL for an index without one
+
+typedef struct Validation{ // the check of an index opened after an unclean close, a few blocks at a time
+    int indexDesc;
+    int end;       // blocks of the file at the open, the ones after it were written since
+    int next;      // first block the thread has not looked at
+    int unchecked; // blocks under end not checked yet
+    unsigned char* checked; // a bit for every block under end, a block is checked the first time it is read
+    bool done;
+    bool damaged;  // a block that does not make sense was found, the check stopped there
+    bool stop;     // the index was closed, the thread frees it
+    bool exited;   // the thread finished first, the close frees it
+    long records;  // in the blocks as they were when checked
+    long added;    // inserted minus deleted since the open, every change is to a checked block
+    BloomFilter bloom; // built from the blocks checked and every id added meanwhile, NULL bits if not needed
+} Validation;
+
+static Validation* validations[MAX_OPEN_FILES]; // NULL for an index opened after a clean close
+static int validating; // checks not done yet, blocks are only looked up in them while there are any
+
+// the BF layer is not thread safe and the flusher threads use it too, every public function
+// holds this lock. They call each other, so a thread only takes it the first time
+static pthread_mutex_t bfLock = PTHREAD_MUTEX_INITIALIZER;
+static __thread int bfDepth;
+
+static int lockBf(void)
+{
+    if (bfDepth++ == 0)
+        pthread_mutex_lock(&bfLock);
+    return 0;
+}
+
+static void unlockBf(int* unused)
+{
+    (void)unused;
+    if (--bfDepth == 0)
+        pthread_mutex_unlock(&bfLock);
+}
+
+// held until the function returns
+#define LOCK_BF() int bfGuard __attribute__((cleanup(unlockBf), unused)) = lockBf()
+
+static HT_ErrorCode drainBuffer(int indexDesc);
+static HT_ErrorCode scanPages(int indexDesc, HT_PageCallback callback, void* ctx);
+static int slotCount(const HashInfo* info);
+static void checkTouched(int fileDesc, int blockNum, BF_Block* block);
+static void summarySave(const char* fileName, const HashInfo* info, long records);
+
+
+// a BF_Block handle from the pool, a new one is allocated only when the pool is empty
+static BF_Block* takeHandle(void)
 {
-    while (*head) {
-        head = &(*head)->next;
+    if (handleCount > 0)
+        return handlePool[--handleCount];
+    BF_Block* block;
+    BF_Block_Init(&block);
+    return block;
+}
+
+// remember whether a handle holds a pin, so one left pinned by an error is unpinned when it goes back
+static void notePin(BF_Block* block, bool pinned)
+{
+    for (int i = 0; i < pinnedCount; i++) {
+        if (pinnedHandles[i] == block) {
+            if (!pinned)
+                pinnedHandles[i] = pinnedHandles[--pinnedCount];
+            return;
+        }
     }
+    if (pinned && pinnedCount < MAX_HANDLES)
+        pinnedHandles[pinnedCount++] = block;
+}
 
-    (*head) = malloc(sizeof(LL));
-    (*head)->HTblock = hblock;
-    (*head)->next = NULL;
+// BF_GetBlock for the blocks of the files. While an index is checked after an unclean open, a block
+// it did not check yet is checked before the caller sees it, so every change is to a checked block
+static BF_ErrorCode getBlock(int fileDesc, int blockNum, BF_Block* block)
+{
+    BF_ErrorCode code = BF_GetBlock(fileDesc, blockNum, block);
+    if (code == BF_OK) {
+        notePin(block, true);
+        if (validating > 0)
+            checkTouched(fileDesc, blockNum, block);
+    }
+    return code;
 }
 
-bool inLL(LL* head, int blocknum)
+static BF_ErrorCode allocBlock(int fileDesc, BF_Block* block)
 {
-    while (head) {
-        if (head->HTblock == blocknum) {
-            return true;
+    BF_ErrorCode code = BF_AllocateBlock(fileDesc, block);
+    if (code == BF_OK)
+        notePin(block, true);
+    return code;
+}
+
+static BF_ErrorCode unpinBlock(BF_Block* block)
+{
+    notePin(block, false); // not retried if it fails
+    return BF_UnpinBlock(block);
+}
+
+// give a handle back to the pool for the next call
+static void giveHandle(BF_Block* block)
+{
+    if (handleCount < MAX_HANDLES)
+        handlePool[handleCount++] = block;
+    else
+        BF_Block_Destroy(&block);
+}
+
+// the cleanup of HANDLE, a return on an error does not lose the handle or leave its block pinned
+static void dropHandle(BF_Block** block)
+{
+    bool pinned = false;
+    for (int i = 0; i < pinnedCount && !pinned; i++)
+        pinned = pinnedHandles[i] == *block;
+    if (pinned)
+        unpinBlock(*block);
+    giveHandle(*block);
+}
+
+// a handle from the pool, given back when the variable goes out of scope
+#define HANDLE(name) BF_Block* name __attribute__((cleanup(dropHandle))) = takeHandle()
+
+static HT_Metrics metrics = { .slowThresholdNs = SLOW_NS };
+static int opDepth; // operations in progress, an insert inside an upsert is not timed again
+static SlowOperation current; // what the outermost operation in progress has done so far
+
+static long nowNs(void)
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec * 1000000000L + time.tv_nsec;
+}
+
+// the bucket of a latency, exact under LATENCY_STEPS ns and LATENCY_STEPS buckets per power of two after
+static int latencyBucket(long ns)
+{
+    if (ns < LATENCY_STEPS)
+        return ns < 0 ? 0 : (int)ns;
+    int octave = 63 - __builtin_clzl(ns); // ns >= 4 so octave >= 2
+    int bucket = (octave - 1) * LATENCY_STEPS + (int)((ns >> (octave - 2)) & (LATENCY_STEPS - 1));
+    return bucket < LATENCY_BUCKETS ? bucket : LATENCY_BUCKETS - 1;
+}
+
+// the smallest latency of a bucket
+static long bucketStart(int bucket)
+{
+    if (bucket < LATENCY_STEPS)
+        return bucket;
+    int octave = bucket / LATENCY_STEPS + 1;
+    return (long)(LATENCY_STEPS + bucket % LATENCY_STEPS) << (octave - 2);
+}
+
+static long beginOp(MetricOp op, int indexDesc, int id)
+{
+    if (opDepth++ > 0)
+        return 0;
+    memset(&current, 0, sizeof(SlowOperation));
+    current.op = op;
+    current.indexDesc = indexDesc;
+    current.id = id;
+    current.slot = -1;
+    current.depth = -1;
+    current.block = -1;
+    return nowNs();
+}
+
+static void endOp(long start)
+{
+    if (--opDepth > 0)
+        return;
+    long ns = nowNs() - start;
+    LatencyHistogram* histogram = &metrics.latency[current.op];
+    histogram->count += 1;
+    histogram->totalNs += ns;
+    if (ns > histogram->maxNs)
+        histogram->maxNs = ns;
+    histogram->buckets[latencyBucket(ns)] += 1;
+    if (ns >= metrics.slowThresholdNs) {
+        current.ns = ns;
+        metrics.slow[metrics.slowCount++ % SLOW_OPS] = current;
+    }
+}
+
+void HT_GetMetrics(HT_Metrics* copy)
+{
+    LOCK_BF();
+    memcpy(copy, &metrics, sizeof(HT_Metrics));
+}
+
+void HT_ResetMetrics()
+{
+    LOCK_BF();
+    long threshold = metrics.slowThresholdNs;
+    memset(&metrics, 0, sizeof(HT_Metrics));
+    metrics.slowThresholdNs = threshold;
+}
+
+void HT_SetSlowThreshold(long ns)
+{
+    LOCK_BF();
+    metrics.slowThresholdNs = ns;
+}
+
+long HT_LatencyPercentile(const LatencyHistogram* histogram, double fraction)
+{
+    long rank = (long)(fraction * histogram->count + 0.5), seen = 0;
+    if (histogram->count == 0)
+        return 0;
+    if (rank < 1)
+        rank = 1;
+    for (int b = 0; b < LATENCY_BUCKETS - 1; b++) {
+        seen += histogram->buckets[b];
+        if (seen >= rank) { // the last latency of the bucket, never past the slowest one
+            long end = bucketStart(b + 1) - 1;
+            return end < histogram->maxNs ? end : histogram->maxNs;
         }
-        head = head->next;
     }
-    return false;
+    return histogram->maxNs;
 }
 
-void freeLL(LL* head)
+void HT_PrintMetrics()
 {
-    while (head) {
-        LL* u = head;
-        head = head->next;
-        free(u);
+    LOCK_BF();
+    static const char* names[METRIC_OPS] = { "insert", "lookup", "scan" };
+    for (int op = 0; op < METRIC_OPS; op++) {
+        const LatencyHistogram* histogram = &metrics.latency[op];
+        if (histogram->count == 0)
+            continue;
+        printf("%s: %ld ops, mean %ld ns, p50 %ld ns, p99 %ld ns, p99.9 %ld ns, max %ld ns\n", names[op],
+            histogram->count, histogram->totalNs / histogram->count, HT_LatencyPercentile(histogram, 0.5),
+            HT_LatencyPercentile(histogram, 0.99), HT_LatencyPercentile(histogram, 0.999), histogram->maxNs);
+    }
+    printf("Splits: %ld, depth bumps: %ld, doublings: %ld, reinserts: %ld, buffer flushes: %ld\n", metrics.splits,
+        metrics.depthBumps, metrics.doublings, metrics.reinserts, metrics.flushes);
+    long kept = metrics.slowCount < SLOW_OPS ? metrics.slowCount : SLOW_OPS;
+    for (long i = 1; i <= kept; i++) {
+        const SlowOperation* slow = &metrics.slow[(metrics.slowCount - i) % SLOW_OPS];
+        printf("slow %s of id %d on index %d: %ld ns, slot %d, depth %d, block %d, %d splits, %d doublings, %d reinserts\n",
+            names[slow->op], slow->id, slow->indexDesc, slow->ns, slow->slot, slow->depth, slow->block,
+            slow->splits, slow->doublings, slow->reinserts);
     }
 }
 
@@ -77,602 +335,2786 @@ int hashFunction(int id, int depth){
 HT_ErrorCode HT_Init()
 {
     CALL_BF(BF_Init(LRU));
+    HT_ResetMetrics();
     indexTable.fileCount = 0;
     for (int i = 0; i < MAX_OPEN_FILES; i++) {
         indexTable.fileDesc[i] = -1;
+        indexTable.osFile[i] = -1;
     }
     return HT_OK;
 }
 
 HT_ErrorCode HT_CreateIndex(const char* filename, int depth)
 {
-
-    if (indexTable.fileCount == MAX_OPEN_FILES)
-        return HT_ERROR; // if the open files haven't reached the maximum allowed
-
-    int fd1;
-    BF_Block* hashBlock;
-    BF_Block_Init(&hashBlock);
-    CALL_BF(BF_CreateFile(filename));
-    CALL_BF(BF_OpenFile(filename, &fd1));
-
-    // first block hashtable information, the rest just buckets
-    char* data;
-    CALL_BF(BF_AllocateBlock(fd1, hashBlock));
-    data = BF_Block_GetData(hashBlock);
-    HashTable hashTab;
-    hashTab.depth = depth;
-    hashTab.nextHT = -1; // to know this is the end
-    for (int i = 0; i < 64; i++) {
-        hashTab.buckets[i] = -1; // to know this is empty
-    }
-    memcpy(data, &hashTab, sizeof(HashTable));
-
-    BF_Block_SetDirty(hashBlock);
-    CALL_BF(BF_UnpinBlock(hashBlock));
-    CALL_BF(BF_CloseFile(fd1));
-
-    return HT_OK;
+    return HT_CreateIndexMode(filename, depth, EXTENDIBLE);
 }
 
-HT_ErrorCode HT_OpenIndex(const char* fileName, int* indexDesc)
+// the position of a BF file in the index table, -1 if it is not an open index
+static int indexOf(int fileDesc)
 {
-    if (indexTable.fileCount == MAX_OPEN_FILES)
-        return HT_ERROR;
-    int fd;
-    CALL_BF(BF_OpenFile(fileName, &fd));
     for (int i = 0; i < MAX_OPEN_FILES; i++) {
-        // adding the information in the indexTable
-        if (indexTable.fileDesc[i] == -1) {
-            indexTable.fileDesc[i] = fd;
-            indexTable.fileCount += 1; // added a file
-            *indexDesc = i;
-            return HT_OK;
-        }
+        if (indexTable.fileDesc[i] == fileDesc)
+            return i;
     }
-    return HT_ERROR;
+    return -1;
 }
 
-HT_ErrorCode HT_CloseFile(int indexDesc){
+// reserve disk space for the next blocks of an open index a whole extent at a time,
+// past the end of the file so the block counter of the BF layer does not change
+static void reserveBlocks(int fileDesc, int count)
+{
+    int i = indexOf(fileDesc);
+    int blocks;
+    if (i == -1 || indexTable.osFile[i] == -1 || indexTable.extentBlocks[i] <= 0)
+        return;
+    if (BF_GetBlockCounter(fileDesc, &blocks) != BF_OK || blocks + count <= indexTable.reservedEnd[i])
+        return;
 
-    if ((indexDesc < MAX_OPEN_FILES) && (indexDesc > -1) && (indexTable.fileDesc[indexDesc] != -1)) {
-        CALL_BF(BF_CloseFile(indexTable.fileDesc[indexDesc])); // close the file
-        indexTable.fileDesc[indexDesc] = -1; 
-        indexTable.fileCount -= 1;
+    int start = indexTable.reservedEnd[i] > blocks ? indexTable.reservedEnd[i] : blocks;
+    int end = blocks + count + indexTable.extentBlocks[i];
+    end -= end % indexTable.extentBlocks[i]; // extents stay aligned
+#ifdef FALLOC_FL_KEEP_SIZE
+    if (fallocate(indexTable.osFile[i], FALLOC_FL_KEEP_SIZE, (off_t)start * BF_BLOCK_SIZE,
+            (off_t)(end - start) * BF_BLOCK_SIZE) != 0)
+        return; // the file system can not preallocate, the blocks are allocated one by one
+#endif
+    indexTable.reservedEnd[i] = end;
+}
+
+// allocate and pin a new block, its number is returned in blockNum. A block of the reuse
+// list of info is taken first, without info (directory extents) it is always at the end
+static HT_ErrorCode allocateBlock(int fileDesc, HashInfo* info, BF_Block* block, int* blockNum)
+{
+    if (info != NULL && info->freeList != -1) {
+        *blockNum = info->freeList;
+        CALL_BF(getBlock(fileDesc, *blockNum, block));
+        info->freeList = ((Bucket*)BF_Block_GetData(block))->overflow;
+        info->freeBlocks -= 1;
         return HT_OK;
     }
-    return HT_ERROR;
+    reserveBlocks(fileDesc, 1);
+    CALL_BF(allocBlock(fileDesc, block));
+    CALL_BF(BF_GetBlockCounter(fileDesc, blockNum));
+    *blockNum -= 1;
+    return HT_OK;
 }
 
-HT_ErrorCode HT_InsertEntry(int indexDesc, Record record) {
-  int fileDesc;
-  int holdthis = indexDesc;
-  
-  if ((indexDesc < MAX_OPEN_FILES) && (indexDesc > -1) && (indexTable.fileDesc[indexDesc] != -1))
-  {
-    fileDesc = indexTable.fileDesc[indexDesc];
-  }
-  else
-  {
-    return HT_ERROR;
-  }
-  
-  char *hashTab;
-  BF_Block *hashBlock;
-  BF_Block_Init(&hashBlock);
-  CALL_BF(BF_GetBlock(fileDesc, 0, hashBlock)); // first block is the hashtable
-  hashTab = BF_Block_GetData(hashBlock);
-
-  // hash to find the position
-  int whereIsMyPlace = hashFunction(record.id, ((HashTable *)hashTab)->depth);
-  
-  int whichHashTableDoIBelongTo = whereIsMyPlace / 64;
-  for (int i = 0; i < whichHashTableDoIBelongTo; i++)
-  {
-    int nextpos = ((HashTable *)hashTab)->nextHT;
-    CALL_BF(BF_UnpinBlock(hashBlock));
-    CALL_BF(BF_GetBlock(fileDesc, nextpos, hashBlock));
-    hashTab = BF_Block_GetData(hashBlock);
-  }
-  int bucketDesc = ((HashTable *)hashTab)->buckets[whereIsMyPlace % 64];
-
-  if (bucketDesc == -1){ //case where a new bucket is needed
-    BF_Block *litoBucket;
-    BF_Block_Init(&litoBucket);
-    char *data;
-    CALL_BF(BF_AllocateBlock(fileDesc, litoBucket));
-    data = BF_Block_GetData(litoBucket);
-    Bucket bucketino;
-    bucketino.records[0] = record;
-    bucketino.recordCount = 1;
-    bucketino.localDepth = ((HashTable *)hashTab)->depth; // since one block for now will point to this bucket
-    memcpy(data, &bucketino, sizeof(Bucket));
+// put a block on the reuse list of the file, it stays there until allocateBlock takes it
+static HT_ErrorCode freeBlock(int fileDesc, HashInfo* info, int blockNum)
+{
+    HANDLE(block);
+    CALL_BF(getBlock(fileDesc, blockNum, block));
+    Bucket* bucket = (Bucket*)BF_Block_GetData(block);
+    bucket->recordCount = 0;
+    bucket->localDepth = FREE_BLOCK;
+    bucket->overflow = info->freeList;
+    BF_Block_SetDirty(block);
+    CALL_BF(unpinBlock(block));
+    info->freeList = blockNum;
+    info->freeBlocks += 1;
+    return HT_OK;
+}
 
-    BF_Block_SetDirty(litoBucket);
-    CALL_BF(BF_UnpinBlock(litoBucket));
+// number of directory pages in the given number of extents
+static int pagesOf(int segments)
+{
+    return segments == 0 ? 0 : 1 << (segments - 1);
+}
 
-    int newBlockCounter;
-    CALL_BF(BF_GetBlockCounter(fileDesc, &newBlockCounter));
-    ((HashTable *)hashTab)->buckets[whereIsMyPlace % 64] = newBlockCounter - 1;
+// the block of the directory page that holds a slot, found by arithmetic on the extents
+int pageBlock(const HashInfo* info, int slot)
+{
+    int page = slot / MAX_BUCKETS;
+    int segment = 0; // extent i > 0 holds the pages [2^(i-1), 2^i)
+    while (pagesOf(segment + 1) <= page)
+        segment++;
+    return info->segment[segment] + page - (segment == 0 ? 0 : pagesOf(segment));
+}
 
-    
-    BF_Block_SetDirty(hashBlock);      // these have been changed
-    CALL_BF(BF_UnpinBlock(hashBlock)); // unpin block where hashtable resides
+// whether a block of the file is the first block or a page of the directory
+static bool isDirectoryBlock(const HashInfo* info, int block)
+{
+    if (block == 0)
+        return true;
+    for (int i = 0; i < info->segments; i++) {
+        int length = i == 0 ? 1 : pagesOf(i);
+        if (block >= info->segment[i] && block < info->segment[i] + length)
+            return true;
+    }
+    return false;
+}
 
-    return HT_OK;
-  }
-  else
-  { // if the bucket already exists
-    
-    char *bucketData;
-    BF_Block *bucketBlock;
-    BF_Block_Init(&bucketBlock);
-    CALL_BF(BF_GetBlock(fileDesc, bucketDesc, bucketBlock));
-    bucketData = BF_Block_GetData(bucketBlock);
-    // if it's full
-    if (((Bucket *)bucketData)->recordCount == 8){
-      if (((HashTable *)hashTab)->depth > ((Bucket *)bucketData)->localDepth)
-      { // Bucket splitting
-        
-        // check if they don't hash in the same
-        int count =0;
-        for (int i = 0; i < ((Bucket *)bucketData)->recordCount; i++){
-          Record r = ((Bucket *)bucketData)->records[i];
-          int whereNew = hashFunction(r.id, ((HashTable *)hashTab)->depth);
-          if (whereNew == whereIsMyPlace) count++;
-        }
-        if (count==8){
-          
-          // update the local depth
-          ((Bucket *)bucketData)->localDepth = ((HashTable *)hashTab)->depth;
-          
-          // update the hash table pointers to the bucket
-          int parseThrough = (int)pow(2.0, (double)(((HashTable *)hashTab)->depth));
-          if (parseThrough > 64)
-          {
-            parseThrough = 64;
-          }
-          char* hashu;
-          BF_Block *helpingBlock;
-          BF_Block_Init(&helpingBlock);
-          int HTindex=0;
-          do{
-            CALL_BF(BF_GetBlock(fileDesc, HTindex, helpingBlock));
-            hashu = BF_Block_GetData(helpingBlock);
-            for (int jj=0;jj<parseThrough;jj++){
-              if (((HashTable *)hashu)->buckets[jj]== bucketDesc&& jj!=whereIsMyPlace){
-                // remove the pointer to the bucket
-                ((HashTable *)hashu)->buckets[jj]=-1;
-              }
-            }
-            HTindex = ((HashTable *)hashu)->nextHT;
-            BF_Block_SetDirty(helpingBlock);
-            CALL_BF(BF_UnpinBlock(helpingBlock));
-            if (HTindex!=-1) BF_UnpinBlock(helpingBlock);
-          }while(HTindex!=-1);
-          BF_Block_SetDirty(bucketBlock);
-          BF_UnpinBlock(bucketBlock);
-          BF_Block_SetDirty(hashBlock);
-          BF_UnpinBlock(hashBlock);
-
-          // recursively call insert to cause a doubling of size
-          return HT_InsertEntry(holdthis, record);
-        }
-
-        BF_Block *litoBucket;
-        BF_Block_Init(&litoBucket);
-        char *data;
-        CALL_BF(BF_AllocateBlock(fileDesc, litoBucket));
-        data = BF_Block_GetData(litoBucket);
-        Bucket bucketino;
-        Bucket tempBucket;
-        // initialise the new buckets
-        int bucketino_records = 0;
-        int bucketdata_records = 0;
-        int oldBucketPosition = ((HashTable *)hashTab)->buckets[whereIsMyPlace % 64];
-        int originalPositions[8];
-        for (int i = 0; i < ((Bucket *)bucketData)->recordCount; i++)
-        {
-          Record r = ((Bucket *)bucketData)->records[i];
-          int whereNew = hashFunction(r.id, ((HashTable *)hashTab)->depth);
-          originalPositions[i]=r.id; // keep this for update
-          if (whereNew == whereIsMyPlace)
-          { // old block
-            tempBucket.records[bucketdata_records] = r;
-            tempBucket.recordCount = ++bucketdata_records;
-          }
-          else
-          { //new block
-            bucketino.records[bucketino_records] = r;
-            bucketino.recordCount = ++bucketino_records;
-          }
-        }
-
-        // insert the new record
-        int whereNew = hashFunction(record.id, ((HashTable *)hashTab)->depth);
-        int indexForSecondaryUpdate = 0;
-        int newrecordgoestoold =1;
-        if (whereNew == whereIsMyPlace)
-        { // old block
-          tempBucket.records[bucketdata_records] = record;
-          indexForSecondaryUpdate=bucketdata_records;
-          tempBucket.recordCount = ++bucketdata_records;
-        }
-        else
-        { //new block
-          newrecordgoestoold = 0;
-          bucketino.records[bucketino_records] = record;
-          indexForSecondaryUpdate=bucketino_records;
-          bucketino.recordCount = ++bucketino_records;
-        }
-
-        tempBucket.localDepth =  0; // these are adjusted further down
-        bucketino.localDepth = 0;
-        memcpy(bucketData, &tempBucket, sizeof(Bucket));
-        memcpy(data, &bucketino, sizeof(Bucket));
-
-        int newBlockCounter;
-        CALL_BF(BF_GetBlockCounter(fileDesc, &newBlockCounter));
-        int newBucketPosition = newBlockCounter - 1;
-
-
-        // update pointers
-        int K = 0; // counter to how many point to the bucket now
-        int arrows[8];
-        for (int j = 0; j < 8; j++){
-          arrows[j] = -1;
-        }
-        for (int j = 0; j < ((Bucket *)bucketData)->recordCount; j++){
-          char *whichHashTablePointsToMe;
-          BF_Block *hashBlock3;
-          BF_Block_Init(&hashBlock3);
-          int whoPointsToMe = hashFunction(((Bucket *)bucketData)->records[j].id, ((HashTable *)hashTab)->depth);
-          int unique = 1;
-          for (int i = 0; i < 8; i++)
-          {
-            if (arrows[i] == whoPointsToMe)
-              unique = 0;
-          }
-          if (unique == 1)
-          {
-            arrows[j] = whoPointsToMe;
-            K++;
-          }
-          CALL_BF(BF_GetBlock(fileDesc, 0, hashBlock3)); // first block hashtable
-          whichHashTablePointsToMe = BF_Block_GetData(hashBlock3);
-          for (int i = 0; i < whoPointsToMe / 64; i++)
-          {
-            int nextpos = ((HashTable *)whichHashTablePointsToMe)->nextHT;
-            CALL_BF(BF_UnpinBlock(hashBlock));
-            CALL_BF(BF_GetBlock(fileDesc, nextpos, hashBlock3));
-            whichHashTablePointsToMe = BF_Block_GetData(hashBlock3);
-          }
-          ((HashTable *)whichHashTablePointsToMe)->buckets[whoPointsToMe % 64] = oldBucketPosition;
-          
-        }
-        ((Bucket *)bucketData)->localDepth = ((HashTable *)hashTab)->depth - (int)log2(K);
-
-        // new bucket
-        K = 0;
-        for (int j = 0; j < 8; j++)
-        {
-          arrows[j] = -1;
-        }
-        for (int j = 0; j < ((Bucket *)data)->recordCount; j++)
-        {
-          char *whichHashTablePointsToMe;
-          BF_Block *hashBlock3;
-          BF_Block_Init(&hashBlock3);
-          int whoPointsToMe = hashFunction(((Bucket *)data)->records[j].id, ((HashTable *)hashTab)->depth);
-          int unique = 1;
-          for (int i = 0; i < 8; i++)
-          {
-            if (arrows[i] == whoPointsToMe)
-              unique = 0;
-          }
-          if (unique == 1)
-          {
-            arrows[j] = whoPointsToMe;
-            K++;
-          }
-          CALL_BF(BF_GetBlock(fileDesc, 0, hashBlock3)); // first block that is the hashtable
-          whichHashTablePointsToMe = BF_Block_GetData(hashBlock3);
-          for (int i = 0; i < whoPointsToMe / 64; i++)
-          {
-            int nextpos = ((HashTable *)whichHashTablePointsToMe)->nextHT;
-            CALL_BF(BF_UnpinBlock(hashBlock));
-            CALL_BF(BF_GetBlock(fileDesc, nextpos, hashBlock3)); // first block that is the hashtable
-            whichHashTablePointsToMe = BF_Block_GetData(hashBlock3);
-          }
-          ((HashTable *)whichHashTablePointsToMe)->buckets[whoPointsToMe % 64] = newBucketPosition;
-        
-          
-          BF_Block_SetDirty(hashBlock3);
-          CALL_BF(BF_UnpinBlock(hashBlock3));
-        }                                    
-        ((Bucket *)data)->localDepth = ((HashTable *)hashTab)->depth - (int)log2(K);
-        BF_Block_SetDirty(litoBucket);
-        CALL_BF(BF_UnpinBlock(litoBucket));
-        BF_Block_SetDirty(bucketBlock);
-        CALL_BF(BF_UnpinBlock(bucketBlock));
-        BF_Block_SetDirty(hashBlock);
-        CALL_BF(BF_UnpinBlock(hashBlock));
+// read the first block of the file, an open index keeps a copy of it
+static HT_ErrorCode readInfo(int fileDesc, HashInfo* info)
+{
+    int i = indexOf(fileDesc);
+    if (i != -1 && indexTable.infoCached[i]) {
+        memcpy(info, &indexTable.info[i], sizeof(HashInfo));
         return HT_OK;
-      }
-      else if (((HashTable *)hashTab)->depth == ((Bucket *)bucketData)->localDepth)
-      { // double the hash table size
-        int new_depth = ((HashTable *)hashTab)->depth + 1;
-        int newBlockCounter;
-        if (new_depth > 6) { // 6 because 2^6=64 size of one structure in this model
-          int howManyHTsToMake = (int)pow(2.0, (double)(new_depth - 7));
-          char *hashuToLink;
-          BF_Block *helpingBlock;
-          BF_Block_Init(&helpingBlock);
-          int HTindex=0;
-          do{
-            CALL_BF(BF_GetBlock(fileDesc, HTindex, helpingBlock));
-            hashuToLink = BF_Block_GetData(helpingBlock);
-            HTindex = ((HashTable *)hashuToLink)->nextHT;
-            if (HTindex!=-1) BF_UnpinBlock(helpingBlock);
-          }while(HTindex!=-1);
-          for (int i = 0; i < howManyHTsToMake; i++){ // create new HTs if needed
-            BF_Block *newHashBlock;
-            BF_Block_Init(&newHashBlock);
-            char *freshData;
-            CALL_BF(BF_AllocateBlock(fileDesc, newHashBlock));
-            freshData = BF_Block_GetData(newHashBlock);
-            HashTable newhashTab;
-            newhashTab.depth = ((HashTable *)hashuToLink)->depth; // keep the old depth
-            newhashTab.nextHT = -1;                               // to highlight the end
-            for (int i = 0; i < 64; i++)
-            {
-              newhashTab.buckets[i] = -1; // that it's empty
-            }
-            memcpy(freshData, &newhashTab, sizeof(HashTable));
-            BF_Block_SetDirty(newHashBlock);
-            CALL_BF(BF_UnpinBlock(newHashBlock));
-            CALL_BF(BF_GetBlockCounter(fileDesc, &newBlockCounter));
-            ((HashTable *)hashuToLink)->nextHT = newBlockCounter - 1;
-            BF_Block_SetDirty(helpingBlock);
-            CALL_BF(BF_UnpinBlock(helpingBlock));
-            HTindex = newBlockCounter - 1;
-            CALL_BF(BF_GetBlock(fileDesc, HTindex, helpingBlock));
-            hashuToLink = BF_Block_GetData(helpingBlock);
-          }
-          BF_Block_SetDirty(helpingBlock);
-          CALL_BF(BF_UnpinBlock(helpingBlock));
-        }
-
-        // use the buddy system to make the pointers
-        char *hashTabChanges;
-        char *temporaryHT;
-        int newSize = (int)pow(2.0, (double)new_depth);
-        int HTindex = 0;
-        int hashtableIndicator = 0;
-        BF_Block *hashBlock2;
-        BF_Block_Init(&hashBlock2);
-        BF_Block *helpingHashBlock;
-        BF_Block_Init(&helpingHashBlock);
-
-        do
-        {
-          CALL_BF(BF_GetBlock(fileDesc, HTindex, hashBlock2)); // first block
-          hashTabChanges = BF_Block_GetData(hashBlock2);
-          ((HashTable *)hashTabChanges)->depth = new_depth;
-          int parseThrough = newSize > 64 ? 64 : newSize;
-        
-          for (int index = 0; index < parseThrough; index++){
-            // old HT pointers to the new using the buddies
-            int buddyIndex = index + newSize;
-            int whichHTbuddyBelongsTo = buddyIndex/64;
-            
-            int HTindexHelping=0;
-            CALL_BF(BF_GetBlock(fileDesc, HTindexHelping, helpingHashBlock));
-            temporaryHT =  BF_Block_GetData(helpingHashBlock);
-            HTindexHelping = ((HashTable *)temporaryHT)->nextHT;
-            
-            for (int g =0; g<whichHTbuddyBelongsTo-1; g++){
-              CALL_BF(BF_UnpinBlock(helpingHashBlock));
-              CALL_BF(BF_GetBlock(fileDesc, HTindexHelping, helpingHashBlock));
-              temporaryHT =  BF_Block_GetData(helpingHashBlock);
-              HTindexHelping = ((HashTable *)temporaryHT)->nextHT;
-            }
-            // buddy of power two points to the same bucket
-            ((HashTable *)temporaryHT)->buckets[buddyIndex%64] = ((HashTable *)hashTabChanges)->buckets[index];
-            BF_Block_SetDirty(helpingHashBlock);
-            CALL_BF(BF_UnpinBlock(helpingHashBlock));
-
-          }
-          HTindex = ((HashTable *)hashTabChanges)->nextHT;
-          hashtableIndicator+=1;
-          BF_Block_SetDirty(hashBlock2);
-          CALL_BF(BF_UnpinBlock(hashBlock2));
-
-        } while (HTindex != -1);
-
-        BF_Block_SetDirty(hashBlock2);
-        BF_UnpinBlock(hashBlock2);
-        BF_Block_SetDirty(helpingHashBlock);
-        BF_UnpinBlock(helpingHashBlock);
-        BF_Block_SetDirty(bucketBlock);
-        BF_UnpinBlock(bucketBlock);
-        BF_Block_SetDirty(hashBlock);
-        BF_UnpinBlock(hashBlock);
-        return HT_InsertEntry(holdthis, record); 
-      }
-      else
-      {
-        return HT_ERROR; // if there was an error with the depths
-      }
     }
-    else
-    { // if the bucket had space just place it inside
-      int newIndexofRec = ((Bucket *)bucketData)->recordCount;
-      ((Bucket *)bucketData)->records[newIndexofRec] = record;
-      ((Bucket *)bucketData)->recordCount += 1;
-
-      BF_Block_SetDirty(bucketBlock);
-      CALL_BF(BF_UnpinBlock(bucketBlock));
-      BF_Block_SetDirty(hashBlock);
-      CALL_BF(BF_UnpinBlock(hashBlock));
-      return HT_OK;
+    HANDLE(infoBlock);
+    CALL_BF(getBlock(fileDesc, 0, infoBlock));
+    memcpy(info, BF_Block_GetData(infoBlock), sizeof(HashInfo));
+    CALL_BF(unpinBlock(infoBlock));
+    if (i != -1) {
+        memcpy(&indexTable.info[i], info, sizeof(HashInfo));
+        indexTable.infoCached[i] = true;
     }
-  }
-  return HT_ERROR;
+    return HT_OK;
 }
 
-
-HT_ErrorCode HT_PrintAllEntries(int indexDesc, int* id) 
+// write back the first block of the file and the copy of an open index
+static HT_ErrorCode writeInfo(int fileDesc, const HashInfo* info)
 {
- 
-    int fileDesc;
-    if ((indexDesc < MAX_OPEN_FILES) && (indexDesc > -1) && (indexTable.fileDesc[indexDesc] != -1)) {
-        fileDesc = indexTable.fileDesc[indexDesc];
-    } else return HT_ERROR;
-
-    int num_of_blocks;
-    CALL_BF(BF_GetBlockCounter(fileDesc, &num_of_blocks));
-    if(num_of_blocks == 1){
-        return HT_ERROR;
+    HANDLE(infoBlock);
+    CALL_BF(getBlock(fileDesc, 0, infoBlock));
+    memcpy(BF_Block_GetData(infoBlock), info, sizeof(HashInfo));
+    BF_Block_SetDirty(infoBlock);
+    CALL_BF(unpinBlock(infoBlock));
+    int i = indexOf(fileDesc);
+    if (i != -1) {
+        memcpy(&indexTable.info[i], info, sizeof(HashInfo));
+        indexTable.infoCached[i] = true;
     }
+    return HT_OK;
+}
 
-    BF_Block* hashBlock;
-    BF_Block_Init(&hashBlock);
-    CALL_BF(BF_GetBlock(fileDesc, 0, hashBlock));
-    char* hashTab = BF_Block_GetData(hashBlock);
+// append the next extent of the directory as consecutive blocks at the end of the file,
+// either empty or as a copy of all the pages before it (the buddies when doubling)
+static HT_ErrorCode addSegment(int fileDesc, HashInfo* info, bool copy)
+{
+    if (info->segments == MAX_SEGMENTS)
+        return HT_ERROR;
+    int pages = info->segments == 0 ? 1 : pagesOf(info->segments);
+    int first;
+    CALL_BF(BF_GetBlockCounter(fileDesc, &first));
+    reserveBlocks(fileDesc, pages); // the whole extent at once
 
-    if (id != NULL) {
-        int whereIsMyPlace = hashFunction(*id, ((HashTable*)hashTab)->depth);
-        BF_Block* bucket;
-        BF_Block_Init(&bucket);
-        int whichHashTableDoIBelongTo = whereIsMyPlace / 64;
-        for (int i = 0; i < whichHashTableDoIBelongTo; i++) {
-            CALL_BF(
-                BF_GetBlock(fileDesc, ((HashTable*)hashTab)->nextHT, hashBlock));
-            hashTab = BF_Block_GetData(hashBlock);
-        }
-        int whichHashTableSlot = whereIsMyPlace % 64;
-        int whichfblock = ((HashTable*)hashTab)->buckets[whichHashTableSlot];
-        if (whichfblock == -1) {
-            printf("ID doesn't exist\n");
-            return HT_OK;
-        }
-        CALL_BF(BF_GetBlock(fileDesc, whichfblock, bucket));
-        char* data = BF_Block_GetData(bucket);
-        for (int i = 0; i < ((Bucket*)data)->recordCount; i++) {
-            Record r = ((Bucket*)data)->records[i];
-            if (r.id == *id) {
-                printf("ID: %d, name: %s, surname: %s, city: %s\n", r.id, r.name,
-                    r.surname, r.city);
-            }
-        }
-        BF_UnpinBlock(bucket);
-    } else {
-        LL* explorer = NULL; //traverse blocks
-        int HT_block = 0;
-        do {
-            insertLL(HT_block, &explorer); //get which blocks are hashblocks
-            CALL_BF(BF_GetBlock(fileDesc, HT_block, hashBlock));
-            char* hashTab = BF_Block_GetData(hashBlock);
-            HT_block = ((HashTable*)hashTab)->nextHT;
-            BF_UnpinBlock(hashBlock);
-        } while (HT_block != -1); // no more hash table puzzle pieces
-        BF_Block* bucketBlock;
-        int howManyBlocks;
-        BF_GetBlockCounter(fileDesc, &howManyBlocks);
-        BF_Block_Init(&bucketBlock);
-        for (int i = 0; i < howManyBlocks; i++) {
-            if (!inLL(explorer, i)) { //if not hash block
-                CALL_BF(BF_GetBlock(fileDesc, i, bucketBlock));
-                char* bucket = BF_Block_GetData(bucketBlock);
-                for (int j = 0; j < ((Bucket*)bucket)->recordCount; j++) {
-                    Record r = ((Bucket*)bucket)->records[j];
-                    printf("ID: %d, name: %s, surname: %s, city: %s\n", r.id, r.name,
-                        r.surname, r.city);
-                }
-                BF_UnpinBlock(bucketBlock);
-            }
+    HANDLE(newHashBlock);
+    HANDLE(hashBlock);
+    for (int page = 0; page < pages; page++) {
+        int newBlock;
+        if (allocateBlock(fileDesc, NULL, newHashBlock, &newBlock) != HT_OK)
+            return HT_ERROR;
+        HashTable* newhashTab = (HashTable*)BF_Block_GetData(newHashBlock);
+        if (copy) {
+            CALL_BF(getBlock(fileDesc, pageBlock(info, page * MAX_BUCKETS), hashBlock));
+            memcpy(newhashTab, BF_Block_GetData(hashBlock), sizeof(HashTable));
+            CALL_BF(unpinBlock(hashBlock));
+        } else {
+            for (int i = 0; i < MAX_BUCKETS; i++)
+                newhashTab->buckets[i] = -1; // to know this is empty
         }
-
-        freeLL(explorer);
+        BF_Block_SetDirty(newHashBlock);
+        CALL_BF(unpinBlock(newHashBlock));
     }
-    return HT_OK;   
+    info->segment[info->segments++] = first;
+    return HT_OK;
 }
 
-HT_ErrorCode HashStatistics(char* fileName)
+HT_ErrorCode HT_CreateIndexMode(const char* filename, int depth, GrowthMode mode)
 {
-    int fileDesc, indexDesc;
-    HT_OpenIndex(fileName, &indexDesc);
-    if ((indexDesc < MAX_OPEN_FILES) && (indexDesc > -1) && (indexTable.fileDesc[indexDesc] != -1)) {
-        fileDesc = indexTable.fileDesc[indexDesc];
-    } else
+    LOCK_BF();
+
+    if (indexTable.fileCount == MAX_OPEN_FILES)
+        return HT_ERROR; // if the open files haven't reached the maximum allowed
+    if (depth < 1 || depth > MAX_DEPTH)
         return HT_ERROR;
 
-    // compute the number of blocks in the file
-    int num_of_blocks;
-    CALL_BF(BF_GetBlockCounter(fileDesc, &num_of_blocks));
-    printf("File '%s' has %d Blocks\n", fileName, num_of_blocks);
-    if(num_of_blocks == 1){
-        printf("No data yet in the file!\n");
-        return HT_OK;
+    int fd1;
+    HANDLE(infoBlock);
+    CALL_BF(BF_CreateFile(filename));
+    CALL_BF(BF_OpenFile(filename, &fd1));
+
+    // first block file information, then the directory extents, the rest just buckets
+    CALL_BF(allocBlock(fd1, infoBlock));
+    CALL_BF(unpinBlock(infoBlock));
+    HashInfo info;
+    memset(&info, 0, sizeof(HashInfo));
+    info.magic = HASH_MAGIC;
+    info.depth = depth;
+    info.mode = mode;
+    info.splitPointer = 0;
+    info.recordCount = 0;
+    info.segments = 0;
+    info.freeList = -1;
+    info.freeBlocks = 0;
+    while (pagesOf(info.segments) * MAX_BUCKETS < (1 << depth)) {
+        if (addSegment(fd1, &info, false) != HT_OK)
+            return HT_ERROR;
     }
+    if (writeInfo(fd1, &info) != HT_OK)
+        return HT_ERROR;
+    CALL_BF(BF_CloseFile(fd1));
+    summarySave(filename, &info, 0); // a new file opens like a cleanly closed one
 
-    int total_buckets = 0; // counter for buckets
-    int total_records = 0; // counter for records
-    int min_records = BF_BLOCK_SIZE / sizeof(Record); // max records + 1
-    int max_records = 0; // min records per bucket - 1
+    return HT_OK;
+}
 
-    char* hashTab;
-    BF_Block* hashBlock;
-    BF_Block_Init(&hashBlock);
+typedef struct BloomHeader{ // start of the fileName.bloom file, the words of the filter follow
+    int magic;
+    int blockCount;
+    int probes;
+    int keys;
+    int capacity;
+} BloomHeader;
 
-    int HTindex = 0; // first block
-    LL* explorer = NULL; // traverse blocks
+#define BLOOM_MAGIC 0x4d4c4248 // "HBLM"
+#define BLOOM_BLOCK_BITS (BLOOM_WORDS * 64)
 
-    do {
-        insertLL(HTindex, &explorer); //get which blocks are hashblocks
-        CALL_BF(BF_GetBlock(fileDesc, HTindex, hashBlock));
-        hashTab = BF_Block_GetData(hashBlock);
-        HTindex = ((HashTable*)hashTab)->nextHT; // update HTindex
-        BF_UnpinBlock(hashBlock);
-    } while (HTindex != -1); // while more HTs
+// splitmix64 of the id, the high half picks the block and the low half the bits in it
+static unsigned long long bloomHash(int id)
+{
+    unsigned long long h = (unsigned)id + 0x9E3779B97F4A7C15ULL;
+    h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    h = (h ^ (h >> 27)) * 0x94D049BB133111EBULL;
+    return h ^ (h >> 31);
+}
 
-    char* data;
-    BF_Block* bucketBlock;
-    BF_Block_Init(&bucketBlock);
+static unsigned long long* bloomBlock(const BloomFilter* bloom, unsigned long long h)
+{
+    return bloom->bits + ((h >> 32) * bloom->blockCount >> 32) * BLOOM_WORDS;
+}
 
-    for (int i = 0; i < num_of_blocks; i++) {
-        if (!inLL(explorer, i)) //if not hash block
-        {
-            CALL_BF(BF_GetBlock(fileDesc, i, bucketBlock));
-            data = BF_Block_GetData(bucketBlock);
+static void bloomAdd(BloomFilter* bloom, int id)
+{
+    unsigned long long h = bloomHash(id);
+    unsigned long long* block = bloomBlock(bloom, h);
+    unsigned bit = (unsigned)h, step = (unsigned)(h >> 16) | 1;
+    for (int i = 0; i < bloom->probes; i++, bit += step)
+        block[(bit % BLOOM_BLOCK_BITS) / 64] |= 1ULL << (bit % 64);
+    bloom->keys += 1;
+}
 
-            if (((Bucket*)data)->recordCount > max_records)
-                max_records = ((Bucket*)data)->recordCount;
+static bool bloomTest(const BloomFilter* bloom, int id)
+{
+    unsigned long long h = bloomHash(id);
+    const unsigned long long* block = bloomBlock(bloom, h);
+    unsigned bit = (unsigned)h, step = (unsigned)(h >> 16) | 1;
+    for (int i = 0; i < bloom->probes; i++, bit += step) {
+        if (!(block[(bit % BLOOM_BLOCK_BITS) / 64] & (1ULL << (bit % 64))))
+            return false;
+    }
+    return true;
+}
 
-            if (((Bucket*)data)->recordCount < min_records)
-                min_records = ((Bucket*)data)->recordCount;
+// an empty filter for capacity ids, about 0.69 probes per bit of an id is the best
+static bool bloomCreate(BloomFilter* bloom, int capacity, int bitsPerKey)
+{
+    long bits = (long)capacity * bitsPerKey;
+    memset(bloom, 0, sizeof(BloomFilter));
+    bloom->blockCount = (bits + BLOOM_BLOCK_BITS - 1) / BLOOM_BLOCK_BITS;
+    bloom->probes = (int)(bitsPerKey * 0.69 + 0.5);
+    if (bloom->probes < 1)
+        bloom->probes = 1;
+    if (bloom->probes > 16)
+        bloom->probes = 16;
+    bloom->capacity = capacity;
+    bloom->bits = calloc((size_t)bloom->blockCount * BLOOM_WORDS, sizeof(unsigned long long));
+    return bloom->bits != NULL;
+}
 
-            total_records += ((Bucket*)data)->recordCount;
-            total_buckets++;
-            BF_UnpinBlock(bucketBlock);
-        }
-    }
-    freeLL(explorer);
+static void bloomFree(BloomFilter* bloom)
+{
+    free(bloom->bits);
+    memset(bloom, 0, sizeof(BloomFilter));
+}
 
-    if (total_buckets!=0){
-      // computing using records in buckets
-      double average = total_records / total_buckets;
+static void bloomPage(const Record* records, int count, void* ctx)
+{
+    for (int i = 0; i < count; i++) {
+        if (!bloomTest(ctx, records[i].id)) // duplicates count once
+            bloomAdd(ctx, records[i].id);
+    }
+}
 
-      if ((min_records == BF_BLOCK_SIZE / sizeof(Record)) || (max_records == 0))
-          return HT_ERROR;
+// build the filter of an open index again from its records, sized for a full bucket in every
+// block or for minKeys ids if more
+static HT_ErrorCode bloomBuild(int indexDesc, int bitsPerKey, int minKeys)
+{
+    int blocks;
+    CALL_BF(BF_GetBlockCounter(indexTable.fileDesc[indexDesc], &blocks));
+    int capacity = blocks * MAX_RECORDS > minKeys ? blocks * MAX_RECORDS : minKeys;
+    if (capacity < BLOOM_MIN_KEYS)
+        capacity = BLOOM_MIN_KEYS;
+    BloomFilter bloom;
+    if (!bloomCreate(&bloom, capacity, bitsPerKey))
+        return HT_ERROR;
+    bloom.negatives = indexTable.bloom[indexDesc].negatives;
+    bloom.falsePositives = indexTable.bloom[indexDesc].falsePositives;
+    if (scanPages(indexDesc, bloomPage, &bloom) != HT_OK) {
+        bloomFree(&bloom);
+        return HT_ERROR;
+    }
+    const WriteBuffer* buffer = writeBuffers[indexDesc];
+    if (buffer != NULL) { // inserts that are not in the file yet
+        int half = 1 - buffer->active;
+        bloomPage(buffer->records[buffer->active], buffer->count[buffer->active], &bloom);
+        if (buffer->flushing)
+            bloomPage(buffer->records[half] + buffer->flushed, buffer->count[half] - buffer->flushed, &bloom);
+    }
+    bloomFree(&indexTable.bloom[indexDesc]);
+    indexTable.bloom[indexDesc] = bloom;
+    return HT_OK;
+}
 
-      // printing the statistics
-      printf("Minimum Records: %d\n", min_records);
-      printf("Average Records: %f\n", average);
-      printf("Maximum Records: %d\n", max_records);
+static void bloomFileName(int indexDesc, char* name)
+{
+    snprintf(name, MAX_FILE_NAME + 8, "%s.bloom", indexTable.fileName[indexDesc]);
+}
 
+// read the filter saved at the last close, false if there is none or it is damaged
+static bool bloomLoad(int indexDesc)
+{
+    char name[MAX_FILE_NAME + 8];
+    bloomFileName(indexDesc, name);
+    FILE* file = fopen(name, "rb");
+    if (file == NULL)
+        return false;
+    BloomHeader header;
+    BloomFilter* bloom = &indexTable.bloom[indexDesc];
+    bool ok = fread(&header, sizeof(BloomHeader), 1, file) == 1 && header.magic == BLOOM_MAGIC &&
+              header.blockCount > 0 && header.probes > 0;
+    if (ok) {
+        memset(bloom, 0, sizeof(BloomFilter));
+        bloom->blockCount = header.blockCount;
+        bloom->probes = header.probes;
+        bloom->keys = header.keys;
+        bloom->capacity = header.capacity;
+        bloom->bits = malloc((size_t)header.blockCount * BLOOM_WORDS * sizeof(unsigned long long));
+        ok = bloom->bits != NULL &&
+             fread(bloom->bits, BLOOM_WORDS * sizeof(unsigned long long), header.blockCount, file) == (size_t)header.blockCount;
+        if (!ok)
+            bloomFree(bloom);
     }
+    fclose(file);
+    return ok;
+}
 
-    return HT_OK;
-}
\ No newline at end of file
+// write the filter next to the index, through a temporary file so a crash leaves the old one or none
+static HT_ErrorCode bloomSave(int indexDesc)
+{
+    const BloomFilter* bloom = &indexTable.bloom[indexDesc];
+    char name[MAX_FILE_NAME + 8], tmpName[MAX_FILE_NAME + 16];
+    bloomFileName(indexDesc, name);
+    snprintf(tmpName, sizeof(tmpName), "%s.tmp", name);
+    FILE* file = fopen(tmpName, "wb");
+    if (file == NULL)
+        return HT_ERROR;
+    BloomHeader header = { BLOOM_MAGIC, bloom->blockCount, bloom->probes, bloom->keys, bloom->capacity };
+    bool ok = fwrite(&header, sizeof(BloomHeader), 1, file) == 1 &&
+              fwrite(bloom->bits, BLOOM_WORDS * sizeof(unsigned long long), bloom->blockCount, file) == (size_t)bloom->blockCount;
+    ok = fclose(file) == 0 && ok;
+    ok = ok && rename(tmpName, name) == 0;
+    if (!ok)
+        unlink(tmpName);
+    return ok ? HT_OK : HT_ERROR;
+}
+
+// false when the filter of the index is sure that id is not in it
+static bool mayContain(int indexDesc, int id)
+{
+    BloomFilter* bloom = &indexTable.bloom[indexDesc];
+    if (bloom->bits == NULL || bloomTest(bloom, id))
+        return true;
+    bloom->negatives++;
+    return false;
+}
+
+// a lookup that passed the filter found nothing
+static void missedLookup(int indexDesc)
+{
+    if (indexTable.bloom[indexDesc].bits != NULL)
+        indexTable.bloom[indexDesc].falsePositives++;
+}
+
+// add a new id to the filter of the index, growing it when it holds more ids than it was sized for
+static HT_ErrorCode bloomInsert(int indexDesc, const HashInfo* info, int id)
+{
+    BloomFilter* bloom = &indexTable.bloom[indexDesc];
+    Validation* validation = validations[indexDesc];
+    if (validation != NULL && validation->bloom.bits != NULL && !bloomTest(&validation->bloom, id))
+        bloomAdd(&validation->bloom, id); // the filter being built may have read its bucket already
+    if (bloom->bits == NULL || bloomTest(bloom, id))
+        return HT_OK; // an id that is already there sets no new bits
+    if (bloom->keys >= bloom->capacity && bloomBuild(indexDesc, info->bloomBits, bloom->keys * 2) != HT_OK)
+        return HT_ERROR;
+    bloomAdd(bloom, id);
+    return HT_OK;
+}
+
+typedef struct SummaryHeader{ // the fileName.summary file, written at a clean close
+    int magic;
+    int blocks;
+    long size;       // the file as it was left, a file changed or replaced since does not match
+    long modifiedNs;
+    long inode;
+    long records;    // extendible hashing, -1 if not known
+    HashInfo info;   // the first block
+    unsigned checksum; // of everything before it
+} SummaryHeader;
+
+#define SUMMARY_MAGIC 0x4d535448 // "HTSM"
+
+static void summaryFileName(const char* fileName, char* name)
+{
+    snprintf(name, MAX_FILE_NAME + 8, "%s.summary", fileName);
+}
+
+// FNV-1a of the summary up to its checksum
+static unsigned summaryChecksum(const SummaryHeader* summary)
+{
+    const unsigned char* bytes = (const unsigned char*)summary;
+    unsigned hash = 2166136261u;
+    for (size_t i = 0; i < offsetof(SummaryHeader, checksum); i++)
+        hash = (hash ^ bytes[i]) * 16777619u;
+    return hash;
+}
+
+// the file as it is on disk now, false if it can not be read
+static bool summaryStat(const char* fileName, SummaryHeader* summary)
+{
+    struct stat status;
+    if (stat(fileName, &status) != 0)
+        return false;
+    summary->blocks = (int)(status.st_size / BF_BLOCK_SIZE);
+    summary->size = status.st_size;
+    summary->modifiedNs = status.st_mtim.tv_sec * 1000000000L + status.st_mtim.tv_nsec;
+    summary->inode = (long)status.st_ino;
+    return true;
+}
+
+// write the summary of a closed file through a temporary file, like the filter. Without one the
+// next open only checks the file, so a failure is not an error of the close
+static void summarySave(const char* fileName, const HashInfo* info, long records)
+{
+    SummaryHeader summary;
+    memset(&summary, 0, sizeof(SummaryHeader)); // the padding is in the checksum too
+    if (!summaryStat(fileName, &summary))
+        return;
+    summary.magic = SUMMARY_MAGIC;
+    summary.records = records;
+    summary.info = *info;
+    summary.checksum = summaryChecksum(&summary);
+
+    char name[MAX_FILE_NAME + 8], tmpName[MAX_FILE_NAME + 16];
+    summaryFileName(fileName, name);
+    snprintf(tmpName, sizeof(tmpName), "%s.tmp", name);
+    FILE* file = fopen(tmpName, "wb");
+    if (file == NULL)
+        return;
+    bool ok = fwrite(&summary, sizeof(SummaryHeader), 1, file) == 1;
+    ok = fclose(file) == 0 && ok;
+    if (!ok || rename(tmpName, name) != 0)
+        unlink(tmpName);
+}
+
+// take the first block and the record count of an index from the summary of its last close,
+// false if there is none or the file changed after it. Like the filter it is only good until
+// the next change, so it is removed and a crash before the next close leaves none
+static bool summaryLoad(int indexDesc)
+{
+    char name[MAX_FILE_NAME + 8];
+    summaryFileName(indexTable.fileName[indexDesc], name);
+    FILE* file = fopen(name, "rb");
+    if (file == NULL)
+        return false;
+    SummaryHeader summary, now;
+    int blocks;
+    memset(&now, 0, sizeof(SummaryHeader));
+    bool ok = fread(&summary, sizeof(SummaryHeader), 1, file) == 1 && summary.magic == SUMMARY_MAGIC &&
+              summary.checksum == summaryChecksum(&summary) && summaryStat(indexTable.fileName[indexDesc], &now) &&
+              now.size == summary.size && now.modifiedNs == summary.modifiedNs && now.inode == summary.inode &&
+              BF_GetBlockCounter(indexTable.fileDesc[indexDesc], &blocks) == BF_OK && blocks == summary.blocks;
+    fclose(file);
+    unlink(name);
+    if (ok) {
+        memcpy(&indexTable.info[indexDesc], &summary.info, sizeof(HashInfo));
+        indexTable.infoCached[indexDesc] = true;
+        indexTable.records[indexDesc] = summary.records;
+    }
+    return ok;
+}
+
+// whether a block number can be the bucket a slot or an overflow link points to
+static bool isBucketBlock(const HashInfo* info, int blocks, int block)
+{
+    return block > 0 && block < blocks && !isDirectoryBlock(info, block);
+}
+
+// the check reached every block, the filter it built replaces the missing one and its count
+// of the records is known
+static void endValidation(Validation* validation)
+{
+    validation->done = true;
+    validating -= 1;
+    if (validation->damaged)
+        return;
+    int i = validation->indexDesc;
+    if (indexTable.info[i].mode == EXTENDIBLE && indexTable.records[i] == -1)
+        indexTable.records[i] = validation->records + validation->added;
+    if (validation->bloom.bits != NULL) {
+        BloomFilter* bloom = &indexTable.bloom[i];
+        if (bloom->bits == NULL) { // HT_SetBloomFilter may have built one meanwhile
+            validation->bloom.negatives = bloom->negatives;
+            validation->bloom.falsePositives = bloom->falsePositives;
+            *bloom = validation->bloom;
+            memset(&validation->bloom, 0, sizeof(BloomFilter));
+        } else
+            bloomFree(&validation->bloom);
+    }
+}
+
+// check a block of an index opened after an unclean close when it is first read. The slots of the
+// directory may only point to buckets, and the buckets need counts and links that make sense
+static void checkTouched(int fileDesc, int blockNum, BF_Block* block)
+{
+    int i = indexOf(fileDesc);
+    Validation* validation = i == -1 ? NULL : validations[i];
+    if (validation == NULL || validation->done || blockNum >= validation->end ||
+            (validation->checked[blockNum / 8] & (1 << (blockNum % 8))))
+        return;
+    validation->checked[blockNum / 8] |= 1 << (blockNum % 8);
+    validation->unchecked -= 1;
+
+    HashInfo info;
+    int blocks;
+    if (readInfo(fileDesc, &info) != HT_OK || BF_GetBlockCounter(fileDesc, &blocks) != BF_OK) {
+        validation->damaged = true;
+        endValidation(validation);
+        return;
+    }
+    const char* data = BF_Block_GetData(block);
+    int page = -1;
+    for (int s = 0; s < info.segments && page == -1; s++) {
+        int length = s == 0 ? 1 : pagesOf(s);
+        if (blockNum >= info.segment[s] && blockNum < info.segment[s] + length)
+            page = (s == 0 ? 0 : pagesOf(s)) + blockNum - info.segment[s];
+    }
+    if (page != -1) { // only the slots in use, the rest may be left from a larger directory
+        const HashTable* hashTab = (const HashTable*)data;
+        int slots = slotCount(&info);
+        for (int k = 0; k < MAX_BUCKETS && page * MAX_BUCKETS + k < slots; k++) {
+            if (hashTab->buckets[k] != -1 && !isBucketBlock(&info, blocks, hashTab->buckets[k]))
+                validation->damaged = true;
+        }
+    } else {
+        const Bucket* bucket = (const Bucket*)data;
+        if (bucket->overflow != -1 && !isBucketBlock(&info, blocks, bucket->overflow))
+            validation->damaged = true;
+        else if (bucket->localDepth != FREE_BLOCK) {
+            if (bucket->recordCount < 0 || bucket->recordCount > MAX_RECORDS ||
+                    bucket->localDepth < 0 || bucket->localDepth > MAX_DEPTH)
+                validation->damaged = true;
+            else {
+                validation->records += bucket->recordCount;
+                if (validation->bloom.bits != NULL)
+                    bloomPage(bucket->records, bucket->recordCount, &validation->bloom);
+            }
+        }
+    }
+    if (validation->damaged || validation->unchecked == 0)
+        endValidation(validation);
+}
+
+// read the next blocks the index has not read itself since the open, reading checks them
+static void validateStep(Validation* validation, int count)
+{
+    int fileDesc = indexTable.fileDesc[validation->indexDesc];
+    HANDLE(block);
+    for (; !validation->done && validation->next < validation->end && count > 0; validation->next++) {
+        int b = validation->next;
+        if (validation->checked[b / 8] & (1 << (b % 8)))
+            continue;
+        count--;
+        if (getBlock(fileDesc, b, block) != BF_OK || unpinBlock(block) != BF_OK) {
+            validation->damaged = true;
+            endValidation(validation);
+        }
+    }
+    if (!validation->done && validation->next >= validation->end) // every block is checked
+        endValidation(validation);
+}
+
+// the thread of a check, it lets the callers take the lock after every step
+static void* validateThread(void* arg)
+{
+    Validation* validation = arg;
+    lockBf();
+    while (!validation->stop && !validation->done) {
+        validateStep(validation, VALIDATE_BLOCKS);
+        unlockBf(NULL);
+        sched_yield();
+        lockBf();
+    }
+    if (validation->stop) {
+        bloomFree(&validation->bloom);
+        free(validation->checked);
+        free(validation);
+    } else
+        validation->exited = true;
+    unlockBf(NULL);
+    return NULL;
+}
+
+// check an index opened after an unclean close in the background. Its filter, if it has one and
+// none was saved, is built by the check instead of by reading the whole file before the open returns
+static HT_ErrorCode startValidation(int indexDesc, int bloomBits)
+{
+    int blocks;
+    CALL_BF(BF_GetBlockCounter(indexTable.fileDesc[indexDesc], &blocks));
+    Validation* validation = calloc(1, sizeof(Validation));
+    if (validation == NULL)
+        return HT_ERROR;
+    validation->indexDesc = indexDesc;
+    validation->end = blocks;
+    validation->checked = calloc(blocks / 8 + 1, 1);
+    if (validation->checked == NULL) {
+        free(validation);
+        return HT_ERROR;
+    }
+    validation->checked[0] = 1; // the first block was read by the open
+    validation->unchecked = blocks - 1;
+    if (bloomBits > 0 && indexTable.bloom[indexDesc].bits == NULL) {
+        int capacity = blocks * MAX_RECORDS > BLOOM_MIN_KEYS ? blocks * MAX_RECORDS : BLOOM_MIN_KEYS;
+        if (!bloomCreate(&validation->bloom, capacity, bloomBits)) {
+            free(validation->checked);
+            free(validation);
+            return HT_ERROR;
+        }
+    }
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, validateThread, validation) != 0) {
+        bloomFree(&validation->bloom);
+        free(validation->checked);
+        free(validation);
+        return HT_ERROR;
+    }
+    pthread_detach(thread);
+    validations[indexDesc] = validation;
+    validating += 1;
+    if (validation->unchecked == 0)
+        endValidation(validation);
+    return HT_OK;
+}
+
+// records inserted or deleted, counted in the index or in its check until the check knows them all
+static void countRecords(int indexDesc, long delta)
+{
+    if (indexTable.records[indexDesc] != -1)
+        indexTable.records[indexDesc] += delta;
+    else if (validations[indexDesc] != NULL)
+        validations[indexDesc]->added += delta;
+}
+
+// read the rest of the file in the calling thread, HT_ERROR if it is damaged
+static HT_ErrorCode finishValidation(int indexDesc)
+{
+    Validation* validation = validations[indexDesc];
+    if (validation == NULL)
+        return HT_OK;
+    while (!validation->done)
+        validateStep(validation, VALIDATE_BLOCKS);
+    return validation->damaged ? HT_ERROR : HT_OK;
+}
+
+// the index is closing, its thread or the close frees the check
+static void stopValidation(int indexDesc)
+{
+    Validation* validation = validations[indexDesc];
+    if (validation == NULL)
+        return;
+    validations[indexDesc] = NULL;
+    if (!validation->done)
+        validating -= 1;
+    if (validation->exited) {
+        bloomFree(&validation->bloom);
+        free(validation->checked);
+        free(validation);
+    } else
+        validation->stop = true;
+}
+
+// whether the first block of a file that is not in the index table yet starts with HASH_MAGIC
+static bool hasMagic(int fd)
+{
+    HANDLE(infoBlock);
+    int magic = 0;
+    BF_ErrorCode code = BF_GetBlock(fd, 0, infoBlock);
+    if (code == BF_OK) {
+        magic = ((const HashInfo*)BF_Block_GetData(infoBlock))->magic;
+        code = unpinBlock(infoBlock);
+    }
+    return code == BF_OK && magic == HASH_MAGIC;
+}
+
+// open a file into a free entry of the index table
+static HT_ErrorCode openSlot(const char* fileName, int i)
+{
+    int fd;
+    CALL_BF(BF_OpenFile(fileName, &fd));
+    if (!hasMagic(fd)) { // empty, or in an older layout that would be misread
+        BF_CloseFile(fd);
+        return HT_ERROR;
+    }
+    indexTable.fileDesc[i] = fd;
+    indexTable.fileCount += 1; // added a file
+    // a descriptor of our own to preallocate the file in extents
+    indexTable.osFile[i] = open(fileName, O_RDWR);
+    indexTable.extentBlocks[i] = EXTENT_BLOCKS;
+    indexTable.reservedEnd[i] = 0;
+    indexTable.infoCached[i] = false;
+    indexTable.records[i] = -1;
+    strcpy(indexTable.fileName[i], fileName);
+
+    // after a clean close the first block comes from the summary, after a crash the file opens
+    // at once and is checked in the background
+    indexTable.clean[i] = summaryLoad(i);
+    HashInfo info;
+    if (readInfo(fd, &info) != HT_OK)
+        return HT_ERROR;
+    if (info.bloomBits > 0) {
+        char name[MAX_FILE_NAME + 8];
+        bloomFileName(i, name);
+        // the saved filter is only good until the next change, it is written again at close
+        // and a crash before that leaves none, so the filter is built from the records
+        if (bloomLoad(i))
+            unlink(name);
+        else if (indexTable.clean[i] && bloomBuild(i, info.bloomBits, 0) != HT_OK)
+            return HT_ERROR;
+    }
+    if (!indexTable.clean[i] && startValidation(i, info.bloomBits) != HT_OK)
+        return HT_ERROR;
+    return HT_OK;
+}
+
+HT_ErrorCode HT_OpenIndex(const char* fileName, int* indexDesc)
+{
+    LOCK_BF();
+    if (indexTable.fileCount == MAX_OPEN_FILES || strlen(fileName) >= MAX_FILE_NAME)
+        return HT_ERROR;
+    for (int i = 0; i < MAX_OPEN_FILES; i++) {
+        // adding the information in the indexTable
+        if (indexTable.fileDesc[i] == -1) {
+            *indexDesc = i;
+            return openSlot(fileName, i);
+        }
+    }
+    return HT_ERROR;
+}
+
+HT_ErrorCode HT_SetExtentSize(int indexDesc, int blocks)
+{
+    LOCK_BF();
+    if ((indexDesc < MAX_OPEN_FILES) && (indexDesc > -1) && (indexTable.fileDesc[indexDesc] != -1) && (blocks >= 0)) {
+        indexTable.extentBlocks[indexDesc] = blocks;
+        return HT_OK;
+    }
+    return HT_ERROR;
+}
+
+HT_ErrorCode HT_SetBloomFilter(int indexDesc, int bitsPerKey)
+{
+    LOCK_BF();
+    if ((indexDesc >= MAX_OPEN_FILES) || (indexDesc < 0) || (indexTable.fileDesc[indexDesc] == -1) ||
+        bitsPerKey < 0 || bitsPerKey > 64)
+        return HT_ERROR;
+    int fileDesc = indexTable.fileDesc[indexDesc];
+    HashInfo info;
+    if (readInfo(fileDesc, &info) != HT_OK)
+        return HT_ERROR;
+    info.bloomBits = bitsPerKey;
+    if (writeInfo(fileDesc, &info) != HT_OK)
+        return HT_ERROR;
+    if (bitsPerKey == 0) {
+        char name[MAX_FILE_NAME + 8];
+        bloomFileName(indexDesc, name);
+        unlink(name);
+        bloomFree(&indexTable.bloom[indexDesc]);
+        if (validations[indexDesc] != NULL)
+            bloomFree(&validations[indexDesc]->bloom);
+        return HT_OK;
+    }
+    return bloomBuild(indexDesc, bitsPerKey, 0);
+}
+
+// drop the free blocks at the end of the file from the reuse list, end becomes the
+// first block that is still needed after them so the file can be cut there
+static HT_ErrorCode trimFreeBlocks(int fileDesc, int* end)
+{
+    HashInfo info;
+    if (readInfo(fileDesc, &info) != HT_OK)
+        return HT_ERROR;
+    if (info.freeBlocks == 0)
+        return HT_OK;
+
+    HANDLE(block);
+    while (*end > 1 && !isDirectoryBlock(&info, *end - 1)) {
+        CALL_BF(getBlock(fileDesc, *end - 1, block));
+        bool unused = ((Bucket*)BF_Block_GetData(block))->localDepth == FREE_BLOCK;
+        CALL_BF(unpinBlock(block));
+        if (!unused)
+            break;
+        *end -= 1;
+    }
+
+    // relink the reuse list without the blocks past the end
+    int previous = -1;
+    for (int next = info.freeList; next != -1;) {
+        CALL_BF(getBlock(fileDesc, next, block));
+        int following = ((Bucket*)BF_Block_GetData(block))->overflow;
+        CALL_BF(unpinBlock(block));
+        if (next >= *end) {
+            info.freeBlocks -= 1;
+            if (previous == -1)
+                info.freeList = following;
+            else {
+                CALL_BF(getBlock(fileDesc, previous, block));
+                ((Bucket*)BF_Block_GetData(block))->overflow = following;
+                BF_Block_SetDirty(block);
+                CALL_BF(unpinBlock(block));
+            }
+        } else
+            previous = next;
+        next = following;
+    }
+    return writeInfo(fileDesc, &info);
+}
+
+HT_ErrorCode HT_CloseFile(int indexDesc){
+    LOCK_BF();
+
+    if ((indexDesc < MAX_OPEN_FILES) && (indexDesc > -1) && (indexTable.fileDesc[indexDesc] != -1)) {
+        int blocks, end;
+        HashInfo info;
+        if (HT_SetWriteBuffer(indexDesc, 0) != HT_OK)
+            return HT_ERROR;
+        // the check of an unclean open is finished first, it also counts the records. A damaged
+        // file gets no summary and is checked again at the next open
+        bool clean = finishValidation(indexDesc) == HT_OK;
+        stopValidation(indexDesc);
+        if (indexTable.bloom[indexDesc].bits != NULL) {
+            HT_ErrorCode saved = bloomSave(indexDesc);
+            bloomFree(&indexTable.bloom[indexDesc]);
+            if (saved != HT_OK)
+                return HT_ERROR;
+        }
+        CALL_BF(BF_GetBlockCounter(indexTable.fileDesc[indexDesc], &blocks));
+        end = blocks;
+        if (indexTable.osFile[indexDesc] != -1 && trimFreeBlocks(indexTable.fileDesc[indexDesc], &end) != HT_OK)
+            return HT_ERROR;
+        if (readInfo(indexTable.fileDesc[indexDesc], &info) != HT_OK)
+            return HT_ERROR;
+        CALL_BF(BF_CloseFile(indexTable.fileDesc[indexDesc])); // close the file
+        bool trimmed = true;
+        if (indexTable.osFile[indexDesc] != -1) {
+            // give back the free blocks at the end and the space that was preallocated and never used
+            if (end < blocks || indexTable.reservedEnd[indexDesc] > blocks)
+                trimmed = ftruncate(indexTable.osFile[indexDesc], (off_t)end * BF_BLOCK_SIZE) == 0;
+            close(indexTable.osFile[indexDesc]);
+            indexTable.osFile[indexDesc] = -1;
+        }
+        // the file is closed either way, one that kept its tail gets no summary and is checked at the next open
+        if (clean && trimmed)
+            summarySave(indexTable.fileName[indexDesc], &info, indexTable.records[indexDesc]);
+        indexTable.fileDesc[indexDesc] = -1; 
+        indexTable.fileCount -= 1;
+        return trimmed ? HT_OK : HT_ERROR;
+    }
+    return HT_ERROR;
+}
+
+// read which bucket a slot of the directory points to
+static HT_ErrorCode readSlot(int fileDesc, const HashInfo *info, int slot, int *bucketDesc)
+{
+    HANDLE(hashBlock);
+    CALL_BF(getBlock(fileDesc, pageBlock(info, slot), hashBlock));
+    *bucketDesc = ((HashTable *)BF_Block_GetData(hashBlock))->buckets[slot % MAX_BUCKETS];
+    CALL_BF(unpinBlock(hashBlock));
+    return HT_OK;
+}
+
+// make a slot of the directory point to a bucket
+static HT_ErrorCode writeSlot(int fileDesc, const HashInfo *info, int slot, int bucketDesc)
+{
+    HANDLE(hashBlock);
+    CALL_BF(getBlock(fileDesc, pageBlock(info, slot), hashBlock));
+    ((HashTable *)BF_Block_GetData(hashBlock))->buckets[slot % MAX_BUCKETS] = bucketDesc;
+    BF_Block_SetDirty(hashBlock);
+    CALL_BF(unpinBlock(hashBlock));
+    return HT_OK;
+}
+
+// make the slots first, first + step, ... of the directory point to a bucket,
+// a page of the directory is pinned once for all of its slots
+static HT_ErrorCode pointSlots(int fileDesc, const HashInfo *info, int first, int step, int bucketDesc)
+{
+  HANDLE(hashBlock);
+  int pinned = -1;
+  for (int s = first; s < (1 << info->depth); s += step) {
+    int block = pageBlock(info, s);
+    if (block != pinned) {
+      if (pinned != -1) {
+        BF_Block_SetDirty(hashBlock);
+        CALL_BF(unpinBlock(hashBlock));
+      }
+      CALL_BF(getBlock(fileDesc, block, hashBlock));
+      pinned = block;
+    }
+    ((HashTable *)BF_Block_GetData(hashBlock))->buckets[s % MAX_BUCKETS] = bucketDesc;
+  }
+  if (pinned != -1) {
+    BF_Block_SetDirty(hashBlock);
+    CALL_BF(unpinBlock(hashBlock));
+  }
+  return HT_OK;
+}
+
+// whether all the slots first, first + step, ... of the directory are empty
+static HT_ErrorCode emptySlots(int fileDesc, const HashInfo *info, int first, int step, bool *empty)
+{
+  HANDLE(hashBlock);
+  int pinned = -1;
+  *empty = true;
+  for (int s = first; s < (1 << info->depth) && *empty; s += step) {
+    int block = pageBlock(info, s);
+    if (block != pinned) {
+      if (pinned != -1)
+        CALL_BF(unpinBlock(hashBlock));
+      CALL_BF(getBlock(fileDesc, block, hashBlock));
+      pinned = block;
+    }
+    *empty = ((HashTable *)BF_Block_GetData(hashBlock))->buckets[s % MAX_BUCKETS] == -1;
+  }
+  if (pinned != -1)
+    CALL_BF(unpinBlock(hashBlock));
+  return HT_OK;
+}
+
+// split a full bucket in two using the next bit of the hash (buddy system)
+static HT_ErrorCode splitBucket(int fileDesc, HashInfo *info, int slot, int bucketDesc)
+{
+  HANDLE(bucketBlock);
+  HANDLE(litoBucket);
+  CALL_BF(getBlock(fileDesc, bucketDesc, bucketBlock));
+  int newBucketPosition;
+  if (allocateBlock(fileDesc, info, litoBucket, &newBucketPosition) != HT_OK)
+    return HT_ERROR;
+  Bucket *oldBucket = (Bucket *)BF_Block_GetData(bucketBlock);
+
+  int localDepth = oldBucket->localDepth;
+  Bucket bucketino;
+  bucketino.recordCount = 0;
+  bucketino.localDepth = localDepth + 1;
+  bucketino.overflow = -1;
+  int kept = 0;
+  for (int i = 0; i < oldBucket->recordCount; i++) {
+    Record r = oldBucket->records[i];
+    // the buddy with the new bit set gets the record
+    if ((hashFunction(r.id, localDepth + 1) >> localDepth) & 1)
+      bucketino.records[bucketino.recordCount++] = r;
+    else
+      oldBucket->records[kept++] = r;
+  }
+  metrics.splits++;
+  current.splits++;
+  if (kept == 0 || bucketino.recordCount == 0) // nothing was separated, the insert tries again a level deeper
+    metrics.depthBumps++;
+  oldBucket->recordCount = kept;
+  oldBucket->localDepth = localDepth + 1;
+  // a bucket with overflow blocks holds a single id, the whole chain stays together
+  bool chainMoves = oldBucket->overflow != -1 && bucketino.recordCount != 0;
+  if (chainMoves) {
+    oldBucket->recordCount = bucketino.recordCount;
+    bucketino.recordCount = 0;
+  }
+  memcpy(BF_Block_GetData(litoBucket), &bucketino, sizeof(Bucket));
+
+  BF_Block_SetDirty(litoBucket);
+  CALL_BF(unpinBlock(litoBucket));
+  BF_Block_SetDirty(bucketBlock);
+  CALL_BF(unpinBlock(bucketBlock));
+  info->depthCount[localDepth] -= 1;
+  info->depthCount[localDepth + 1] += 2;
+
+  // every slot that shared the bucket and has the new bit set moves to the new one,
+  // or the other way around when the chain has the new bit set
+  int first = (slot & ((1 << localDepth) - 1)) | (1 << localDepth);
+  if (chainMoves && pointSlots(fileDesc, info, first - (1 << localDepth), 1 << (localDepth + 1), newBucketPosition) != HT_OK)
+    return HT_ERROR;
+  if (pointSlots(fileDesc, info, first, 1 << (localDepth + 1), chainMoves ? bucketDesc : newBucketPosition) != HT_OK)
+    return HT_ERROR;
+  return writeInfo(fileDesc, info);
+}
+
+// double the directory, every new slot points where its buddy does
+static HT_ErrorCode doubleHashTable(int fileDesc, HashInfo *info)
+{
+  int oldSize = 1 << info->depth;
+
+  if (2 * oldSize <= MAX_BUCKETS) { // the new slots fit in the first page
+    HANDLE(hashBlock);
+    CALL_BF(getBlock(fileDesc, info->segment[0], hashBlock));
+    HashTable *hashTab = (HashTable *)BF_Block_GetData(hashBlock);
+    for (int index = 0; index < oldSize; index++)
+      hashTab->buckets[index + oldSize] = hashTab->buckets[index];
+    BF_Block_SetDirty(hashBlock);
+    CALL_BF(unpinBlock(hashBlock));
+  }
+  else if (addSegment(fileDesc, info, true) != HT_OK) { // the new extent is a copy of the old pages
+    return HT_ERROR;
+  }
+
+  info->depth += 1;
+  metrics.doublings++;
+  current.doublings++;
+  return writeInfo(fileDesc, info);
+}
+
+// the slot of the directory that an id hashes to
+int slotOf(const HashInfo *info, int id)
+{
+  int slot = hashFunction(id, info->depth);
+  if (info->mode == LINEAR && slot < info->splitPointer)
+    slot = hashFunction(id, info->depth + 1); // already split in this round
+  return slot;
+}
+
+// write the records in a chain of bucket blocks, filling them in order
+static HT_ErrorCode writeChain(int fileDesc, const int *blocks, int blockCount, const Record *records, int recordCount, int localDepth)
+{
+  HANDLE(bucketBlock);
+  for (int i = 0; i < blockCount; i++) {
+    CALL_BF(getBlock(fileDesc, blocks[i], bucketBlock));
+    Bucket *bucket = (Bucket *)BF_Block_GetData(bucketBlock);
+    bucket->recordCount = recordCount < MAX_RECORDS ? recordCount : MAX_RECORDS;
+    bucket->localDepth = localDepth;
+    bucket->overflow = i + 1 < blockCount ? blocks[i + 1] : -1;
+    memcpy(bucket->records, records, bucket->recordCount * sizeof(Record));
+    records += bucket->recordCount;
+    recordCount -= bucket->recordCount;
+    BF_Block_SetDirty(bucketBlock);
+    CALL_BF(unpinBlock(bucketBlock));
+  }
+  return HT_OK;
+}
+
+// add a block number to a chain
+static void appendBlock(Chain *chain, int block)
+{
+  if (chain->blockCount == chain->blockCapacity) {
+    chain->blockCapacity = chain->blockCapacity == 0 ? 16 : chain->blockCapacity * 2;
+    chain->blocks = realloc(chain->blocks, chain->blockCapacity * sizeof(int));
+  }
+  chain->blocks[chain->blockCount++] = block;
+}
+
+// read the records and the block numbers of a bucket and its overflow blocks after the ones
+// already in the chain, the local depth is the one of the first block read
+static HT_ErrorCode gatherChain(int fileDesc, int bucketDesc, Chain *chain)
+{
+  HANDLE(bucketBlock);
+  for (int next = bucketDesc; next != -1;) {
+    CALL_BF(getBlock(fileDesc, next, bucketBlock));
+    Bucket *bucket = (Bucket *)BF_Block_GetData(bucketBlock);
+    if (chain->recordCount + MAX_RECORDS > chain->recordCapacity) {
+      chain->recordCapacity = chain->recordCapacity == 0 ? 16 * MAX_RECORDS : chain->recordCapacity * 2;
+      chain->records = realloc(chain->records, chain->recordCapacity * sizeof(Record));
+    }
+    if (chain->blockCount == 0)
+      chain->localDepth = bucket->localDepth;
+    appendBlock(chain, next);
+    memcpy(&chain->records[chain->recordCount], bucket->records, bucket->recordCount * sizeof(Record));
+    chain->recordCount += bucket->recordCount;
+    next = bucket->overflow;
+    CALL_BF(unpinBlock(bucketBlock));
+  }
+  return HT_OK;
+}
+
+// linear hashing, split the bucket under the split pointer and move the pointer on
+static HT_ErrorCode linearSplit(int fileDesc, HashInfo *info)
+{
+  int level = info->depth;
+  int splitPointer = info->splitPointer;
+  int newSlot = (1 << level) + splitPointer;
+  while (pagesOf(info->segments) * MAX_BUCKETS <= newSlot) { // the directory grows by an extent
+    if (addSegment(fileDesc, info, false) != HT_OK)
+      return HT_ERROR;
+  }
+  metrics.splits++;
+  current.splits++;
+  int bucketDesc;
+  if (readSlot(fileDesc, info, splitPointer, &bucketDesc) != HT_OK)
+    return HT_ERROR;
+
+  if (bucketDesc != -1) { // an empty slot just moves the pointer
+    Chain *chain = &chainBuffer;
+    chain->blockCount = chain->recordCount = 0;
+    if (gatherChain(fileDesc, bucketDesc, chain) != HT_OK)
+      return HT_ERROR;
+    Record *records = chain->records;
+    int recordsSize = chain->recordCount;
+    HANDLE(bucketBlock);
+
+    // the records that stay go first, the ones with the new bit set after them
+    int kept = 0;
+    for (int i = 0; i < recordsSize; i++) {
+      if (hashFunction(records[i].id, level + 1) == splitPointer) {
+        Record r = records[i];
+        records[i] = records[kept];
+        records[kept++] = r;
+      }
+    }
+
+    // the blocks of the old chain are handed out again, new ones only if they are not enough
+    int oldBlocks = kept == 0 ? 1 : (kept + MAX_RECORDS - 1) / MAX_RECORDS;
+    int newBlocks = recordsSize == kept ? 1 : (recordsSize - kept + MAX_RECORDS - 1) / MAX_RECORDS;
+    while (chain->blockCount < oldBlocks + newBlocks) {
+      int newBlock;
+      if (allocateBlock(fileDesc, info, bucketBlock, &newBlock) != HT_OK)
+        return HT_ERROR;
+      CALL_BF(unpinBlock(bucketBlock));
+      appendBlock(chain, newBlock);
+    }
+
+    // the new bucket gets the last blocks, the old one the rest with any spare ones left empty at the end
+    int oldCount = chain->blockCount - newBlocks;
+    int newBucketPosition = chain->blocks[oldCount];
+    if (writeChain(fileDesc, chain->blocks, oldCount, records, kept, level + 1) != HT_OK ||
+        writeChain(fileDesc, &chain->blocks[oldCount], newBlocks, &records[kept], recordsSize - kept, level + 1) != HT_OK)
+      return HT_ERROR;
+    if (writeSlot(fileDesc, info, newSlot, newBucketPosition) != HT_OK)
+      return HT_ERROR;
+  }
+
+  info->splitPointer += 1;
+  if (info->splitPointer == (1 << info->depth)) { // a new round starts
+    info->depth += 1;
+    info->splitPointer = 0;
+  }
+  return HT_OK;
+}
+
+// linear hashing, count one more record, the load factor decides if the bucket under the split pointer splits
+static HT_ErrorCode linearGrow(int fileDesc, HashInfo *info)
+{
+  info->recordCount += 1;
+  long long capacity = (long long)((1 << info->depth) + info->splitPointer) * MAX_RECORDS;
+  if ((long long)info->recordCount * 100 > capacity * MAX_LOAD && linearSplit(fileDesc, info) != HT_OK)
+    return HT_ERROR;
+  return writeInfo(fileDesc, info);
+}
+
+// the record goes to the first block of the chain of a slot with space, or to a new block at its end
+static HT_ErrorCode chainInsert(int fileDesc, HashInfo *info, int slot, int bucketDesc, Record record)
+{
+  HANDLE(bucketBlock);
+  HANDLE(litoBucket);
+  Bucket *bucket = NULL;
+  if (bucketDesc != -1) {
+    CALL_BF(getBlock(fileDesc, bucketDesc, bucketBlock));
+    bucket = (Bucket *)BF_Block_GetData(bucketBlock);
+    while (bucket->recordCount == MAX_RECORDS && bucket->overflow != -1) {
+      int next = bucket->overflow;
+      CALL_BF(unpinBlock(bucketBlock));
+      CALL_BF(getBlock(fileDesc, next, bucketBlock));
+      bucket = (Bucket *)BF_Block_GetData(bucketBlock);
+    }
+  }
+
+  if (bucket != NULL && bucket->recordCount < MAX_RECORDS) {
+    bucket->records[bucket->recordCount] = record;
+    bucket->recordCount += 1;
+  }
+  else { // a new bucket, or an overflow block at the end of the chain
+    int newBlock;
+    if (allocateBlock(fileDesc, info, litoBucket, &newBlock) != HT_OK)
+      return HT_ERROR;
+    Bucket bucketino;
+    bucketino.records[0] = record;
+    bucketino.recordCount = 1;
+    bucketino.localDepth = bucket != NULL ? bucket->localDepth : 0;
+    bucketino.overflow = -1;
+    memcpy(BF_Block_GetData(litoBucket), &bucketino, sizeof(Bucket));
+    BF_Block_SetDirty(litoBucket);
+    CALL_BF(unpinBlock(litoBucket));
+
+    if (bucket != NULL)
+      bucket->overflow = newBlock;
+    else if (writeSlot(fileDesc, info, slot, newBlock) != HT_OK)
+      return HT_ERROR;
+  }
+  if (bucket != NULL) {
+    BF_Block_SetDirty(bucketBlock);
+    CALL_BF(unpinBlock(bucketBlock));
+  }
+  return HT_OK;
+}
+
+// linear hashing insert, overflow blocks are chained to the bucket until it splits
+static HT_ErrorCode linearInsert(int fileDesc, HashInfo *info, int slot, Record record)
+{
+  int bucketDesc;
+  if (readSlot(fileDesc, info, slot, &bucketDesc) != HT_OK ||
+      chainInsert(fileDesc, info, slot, bucketDesc, record) != HT_OK)
+    return HT_ERROR;
+  return linearGrow(fileDesc, info);
+}
+
+static HT_ErrorCode insertEntry(int indexDesc, Record record) {
+  int fileDesc;
+
+  if ((indexDesc < MAX_OPEN_FILES) && (indexDesc > -1) && (indexTable.fileDesc[indexDesc] != -1))
+  {
+    fileDesc = indexTable.fileDesc[indexDesc];
+  }
+  else
+  {
+    return HT_ERROR;
+  }
+
+  HashInfo info;
+  if (readInfo(fileDesc, &info) != HT_OK) // first block is the file information
+    return HT_ERROR;
+  if (bloomInsert(indexDesc, &info, record.id) != HT_OK)
+    return HT_ERROR;
+  // hash to find the position
+  int whereIsMyPlace = slotOf(&info, record.id);
+  current.slot = whereIsMyPlace;
+  current.depth = info.depth;
+
+  if (info.mode == LINEAR)
+    return linearInsert(fileDesc, &info, whereIsMyPlace, record);
+  int bucketDesc;
+  if (readSlot(fileDesc, &info, whereIsMyPlace, &bucketDesc) != HT_OK)
+    return HT_ERROR;
+  current.block = bucketDesc;
+
+  if (bucketDesc == -1){ //case where a new bucket is needed
+    HANDLE(litoBucket);
+    int newBlock;
+    if (allocateBlock(fileDesc, &info, litoBucket, &newBlock) != HT_OK)
+      return HT_ERROR;
+    Bucket bucketino;
+    bucketino.records[0] = record;
+    bucketino.recordCount = 1;
+    bucketino.localDepth = info.depth; // since one slot for now will point to this bucket
+    bucketino.overflow = -1;
+    memcpy(BF_Block_GetData(litoBucket), &bucketino, sizeof(Bucket));
+
+    BF_Block_SetDirty(litoBucket);
+    CALL_BF(unpinBlock(litoBucket));
+
+    info.depthCount[info.depth] += 1;
+    if (writeSlot(fileDesc, &info, whereIsMyPlace, newBlock) != HT_OK)
+      return HT_ERROR;
+    return writeInfo(fileDesc, &info);
+  }
+
+  HANDLE(bucketBlock);
+  CALL_BF(getBlock(fileDesc, bucketDesc, bucketBlock));
+  Bucket *bucket = (Bucket *)BF_Block_GetData(bucketBlock);
+  if (bucket->recordCount < MAX_RECORDS)
+  { // if the bucket had space just place it inside
+    bucket->records[bucket->recordCount] = record;
+    bucket->recordCount += 1;
+    BF_Block_SetDirty(bucketBlock);
+    CALL_BF(unpinBlock(bucketBlock));
+    return HT_OK;
+  }
+  int localDepth = bucket->localDepth;
+  bool sameId = true;
+  for (int i = 0; i < bucket->recordCount; i++)
+    sameId = sameId && bucket->records[i].id == record.id;
+  CALL_BF(unpinBlock(bucketBlock));
+
+  if (sameId)
+  { // no split can separate records with the same id, they get overflow blocks instead
+    if (chainInsert(fileDesc, &info, whereIsMyPlace, bucketDesc, record) != HT_OK)
+      return HT_ERROR;
+    return writeInfo(fileDesc, &info);
+  }
+  if (info.depth > localDepth)
+  { // Bucket splitting
+    if (splitBucket(fileDesc, &info, whereIsMyPlace, bucketDesc) != HT_OK)
+      return HT_ERROR;
+  }
+  else if (info.depth == localDepth && info.depth < MAX_DEPTH)
+  { // double the hash table size
+    if (doubleHashTable(fileDesc, &info) != HT_OK)
+      return HT_ERROR;
+  }
+  else
+  {
+    return HT_ERROR; // if there was an error with the depths
+  }
+
+  // recursively call insert, the record may need another split
+  metrics.reinserts++;
+  current.reinserts++;
+  return insertEntry(indexDesc, record);
+}
+
+static unsigned sortMask; // the low bits of the ids the records of a half are sorted by
+
+static int compareSlots(const void* a, const void* b)
+{
+  unsigned x = ((const Record *)a)->id & sortMask, y = ((const Record *)b)->id & sortMask;
+  return (x > y) - (x < y);
+}
+
+// records are sorted by the slot they will have once the half is in, not by the one they have now.
+// The buckets then come in slot order at that depth, and the low bits change fastest, so the
+// directory grows evenly instead of one slot taking a whole run while its neighbours are still empty
+static unsigned sortHalf(int fileDesc, const HashInfo *info, Record *records, int count)
+{
+  int blocks;
+  if (BF_GetBlockCounter(fileDesc, &blocks) != BF_OK)
+    blocks = 0;
+  long buckets = blocks + count / MAX_RECORDS;
+  int depth = info->depth;
+  while (depth < MAX_DEPTH && (1L << depth) < buckets)
+    depth++;
+  sortMask = depth >= 32 ? ~0u : (1u << depth) - 1;
+  qsort(records, count, sizeof(Record), compareSlots);
+  return sortMask;
+}
+
+// sort what is left of the half being written out, if the flusher thread has not done it yet
+static HT_ErrorCode sortFlushing(WriteBuffer* buffer)
+{
+  if (buffer->sorted)
+    return HT_OK;
+  int fileDesc = indexTable.fileDesc[buffer->indexDesc];
+  int half = 1 - buffer->active;
+  HashInfo info;
+  if (readInfo(fileDesc, &info) != HT_OK)
+    return HT_ERROR;
+  buffer->sortMask = sortHalf(fileDesc, &info, buffer->records[half] + buffer->flushed, buffer->count[half] - buffer->flushed);
+  buffer->sorted = true;
+  return HT_OK;
+}
+
+// the records of the half being written out that are not in the file yet and sort with id,
+// [*first, *end), found by binary search. None when no half is being written out
+static HT_ErrorCode flushingRange(WriteBuffer* buffer, int id, int *first, int *end)
+{
+  *first = *end = 0;
+  if (!buffer->flushing)
+    return HT_OK;
+  if (sortFlushing(buffer) != HT_OK)
+    return HT_ERROR;
+  const Record* records = buffer->records[1 - buffer->active];
+  int count = buffer->count[1 - buffer->active];
+  unsigned key = (unsigned)id & buffer->sortMask;
+  int low = buffer->flushed, high = count;
+  while (low < high) {
+    int middle = low + (high - low) / 2;
+    if (((unsigned)records[middle].id & buffer->sortMask) < key)
+      low = middle + 1;
+    else
+      high = middle;
+  }
+  *first = *end = low;
+  while (*end < count && ((unsigned)records[*end].id & buffer->sortMask) == key)
+    *end += 1;
+  return HT_OK;
+}
+
+// the table of the active half holds the index of a record plus one, 0 for an empty entry
+static unsigned tableHome(const WriteBuffer* buffer, int id)
+{
+  return ((unsigned)id * 2654435761u) & buffer->tableMask;
+}
+
+static void tableAdd(WriteBuffer* buffer, int at)
+{
+  unsigned i = tableHome(buffer, buffer->records[buffer->active][at].id);
+  while (buffer->table[i] != 0)
+    i = (i + 1) & buffer->tableMask;
+  buffer->table[i] = at + 1;
+}
+
+// the entry of the record at in the table
+static unsigned tableFind(const WriteBuffer* buffer, int at)
+{
+  unsigned i = tableHome(buffer, buffer->records[buffer->active][at].id);
+  while (buffer->table[i] != at + 1)
+    i = (i + 1) & buffer->tableMask;
+  return i;
+}
+
+// empty entry i. The entries after it move back into the hole when their home is not between
+// the hole and them, so a lookup never stops early at it
+static void tableRemove(WriteBuffer* buffer, unsigned i)
+{
+  const Record* records = buffer->records[buffer->active];
+  unsigned mask = buffer->tableMask;
+  for (unsigned j = (i + 1) & mask; buffer->table[j] != 0; j = (j + 1) & mask) {
+    unsigned home = tableHome(buffer, records[buffer->table[j] - 1].id);
+    if (((j - home) & mask) >= ((j - i) & mask)) {
+      buffer->table[i] = buffer->table[j];
+      i = j;
+    }
+  }
+  buffer->table[i] = 0;
+}
+
+// the next record of the active half with id from entry *i of the table on, -1 when there is none
+static int tableNext(const WriteBuffer* buffer, int id, unsigned *i)
+{
+  const Record* records = buffer->records[buffer->active];
+  for (; buffer->table[*i] != 0; *i = (*i + 1) & buffer->tableMask) {
+    if (records[buffer->table[*i] - 1].id == id)
+      return buffer->table[*i] - 1;
+  }
+  return -1;
+}
+
+// the active half is handed to the flusher thread and the other one, already empty, takes the inserts
+static void swapHalves(WriteBuffer* buffer)
+{
+  buffer->active = 1 - buffer->active;
+  buffer->flushing = true;
+  buffer->sorted = false;
+  buffer->flushed = 0;
+  memset(buffer->table, 0, (buffer->tableMask + 1) * sizeof(int));
+}
+
+// insert the first records of a half that hash to the same slot, the bucket is read once for all
+// that fit in it. The rest of the run goes through insertEntry one at a time
+static HT_ErrorCode insertRun(int indexDesc, const HashInfo *info, const Record *records, int count, int *consumed)
+{
+  int fileDesc = indexTable.fileDesc[indexDesc];
+  int slot = slotOf(info, records[0].id);
+  int bucketDesc = -1;
+  *consumed = 0;
+  if (info->mode == EXTENDIBLE && readSlot(fileDesc, info, slot, &bucketDesc) != HT_OK)
+    return HT_ERROR;
+  if (bucketDesc != -1) {
+    HANDLE(bucketBlock);
+    CALL_BF(getBlock(fileDesc, bucketDesc, bucketBlock));
+    Bucket *bucket = (Bucket *)BF_Block_GetData(bucketBlock);
+    while (*consumed < count && bucket->recordCount < MAX_RECORDS && slotOf(info, records[*consumed].id) == slot) {
+      bucket->records[bucket->recordCount] = records[*consumed];
+      bucket->recordCount += 1;
+      *consumed += 1;
+    }
+    if (*consumed > 0)
+      BF_Block_SetDirty(bucketBlock);
+    CALL_BF(unpinBlock(bucketBlock));
+  }
+  if (*consumed == 0) { // no bucket yet, a full one, or linear hashing
+    if (insertEntry(indexDesc, records[0]) != HT_OK)
+      return HT_ERROR;
+    *consumed = 1;
+  }
+  return HT_OK;
+}
+
+// write out the half of the buffer that is not taking inserts, in slot order. The flusher thread
+// lets the lock go every FLUSH_RUNS runs, so a caller can meanwhile take its half back or close
+// the index
+static HT_ErrorCode flushHalf(WriteBuffer* buffer, bool background)
+{
+  int runs = 0;
+  while (buffer->flushing && !buffer->stop) {
+    int half = 1 - buffer->active;
+    Record* records = buffer->records[half];
+    HashInfo info;
+    if (readInfo(indexTable.fileDesc[buffer->indexDesc], &info) != HT_OK)
+      return HT_ERROR;
+    if (sortFlushing(buffer) != HT_OK)
+      return HT_ERROR;
+    if (buffer->flushed == buffer->count[half]) {
+      buffer->count[half] = 0;
+      buffer->flushed = 0;
+      buffer->flushing = false;
+      metrics.flushes++;
+      break;
+    }
+    int consumed;
+    if (insertRun(buffer->indexDesc, &info, records + buffer->flushed, buffer->count[half] - buffer->flushed,
+                  &consumed) != HT_OK)
+      return HT_ERROR;
+    buffer->flushed += consumed;
+    if (background && ++runs % FLUSH_RUNS == 0) {
+      unlockBf(NULL);
+      lockBf();
+    }
+  }
+  return HT_OK;
+}
+
+// the flusher thread of a buffer, it waits for a full half and frees the buffer when the index closes
+static void* flushThread(void* arg)
+{
+  WriteBuffer* buffer = arg;
+  lockBf();
+  while (!buffer->stop) {
+    if (buffer->flushing && buffer->error == HT_OK)
+      buffer->error = flushHalf(buffer, true);
+    else
+      pthread_cond_wait(&buffer->wake, &bfLock);
+  }
+  pthread_cond_destroy(&buffer->wake);
+  free(buffer->records[0]);
+  free(buffer->records[1]);
+  free(buffer->table);
+  free(buffer);
+  unlockBf(NULL);
+  return NULL;
+}
+
+// write every buffered record of the index to the file, before anything that reads all of it
+static HT_ErrorCode drainBuffer(int indexDesc)
+{
+  WriteBuffer* buffer = writeBuffers[indexDesc];
+  if (buffer == NULL)
+    return HT_OK;
+  if (buffer->flushing && flushHalf(buffer, false) != HT_OK)
+    return HT_ERROR;
+  if (buffer->count[buffer->active] > 0) {
+    swapHalves(buffer);
+    if (flushHalf(buffer, false) != HT_OK)
+      return HT_ERROR;
+  }
+  buffer->error = HT_OK;
+  return HT_OK;
+}
+
+HT_ErrorCode HT_SetWriteBuffer(int indexDesc, int records)
+{
+  LOCK_BF();
+  if (indexDesc < 0 || indexDesc >= MAX_OPEN_FILES || indexTable.fileDesc[indexDesc] == -1 || records < 0)
+    return HT_ERROR;
+  WriteBuffer* buffer = writeBuffers[indexDesc];
+  if (buffer != NULL) {
+    if (drainBuffer(indexDesc) != HT_OK)
+      return HT_ERROR;
+    writeBuffers[indexDesc] = NULL;
+    buffer->stop = true; // the thread frees it
+    pthread_cond_signal(&buffer->wake);
+  }
+  if (records == 0)
+    return HT_OK;
+
+  buffer = calloc(1, sizeof(WriteBuffer));
+  if (buffer == NULL)
+    return HT_ERROR;
+  buffer->records[0] = malloc(records * sizeof(Record));
+  buffer->records[1] = malloc(records * sizeof(Record));
+  unsigned entries = 2;
+  while (entries < 2u * records)
+    entries <<= 1;
+  buffer->table = calloc(entries, sizeof(int));
+  buffer->tableMask = entries - 1;
+  buffer->capacity = records;
+  buffer->indexDesc = indexDesc;
+  buffer->error = HT_OK;
+  pthread_t thread;
+  if (buffer->records[0] == NULL || buffer->records[1] == NULL || buffer->table == NULL ||
+      pthread_cond_init(&buffer->wake, NULL) != 0) {
+    free(buffer->records[0]);
+    free(buffer->records[1]);
+    free(buffer->table);
+    free(buffer);
+    return HT_ERROR;
+  }
+  if (pthread_create(&thread, NULL, flushThread, buffer) != 0) {
+    pthread_cond_destroy(&buffer->wake);
+    free(buffer->records[0]);
+    free(buffer->records[1]);
+    free(buffer->table);
+    free(buffer);
+    return HT_ERROR;
+  }
+  pthread_detach(thread);
+  writeBuffers[indexDesc] = buffer;
+  return HT_OK;
+}
+
+HT_ErrorCode HT_Flush(int indexDesc)
+{
+  LOCK_BF();
+  if (indexDesc < 0 || indexDesc >= MAX_OPEN_FILES || indexTable.fileDesc[indexDesc] == -1)
+    return HT_ERROR;
+  return drainBuffer(indexDesc);
+}
+
+// keep a record in the write buffer of the index. A full half is handed to the flusher thread,
+// and if it is still writing out the other one this call finishes that first, so memory stays bounded
+static HT_ErrorCode bufferInsert(int indexDesc, WriteBuffer* buffer, Record record)
+{
+  if (buffer->error != HT_OK)
+    return HT_ERROR;
+  if (buffer->count[buffer->active] == buffer->capacity) {
+    if (buffer->flushing && flushHalf(buffer, false) != HT_OK)
+      return HT_ERROR;
+    swapHalves(buffer);
+    pthread_cond_signal(&buffer->wake);
+  }
+  HashInfo info;
+  if (readInfo(indexTable.fileDesc[indexDesc], &info) != HT_OK || bloomInsert(indexDesc, &info, record.id) != HT_OK)
+    return HT_ERROR;
+  buffer->records[buffer->active][buffer->count[buffer->active]++] = record;
+  tableAdd(buffer, buffer->count[buffer->active] - 1);
+  return HT_OK;
+}
+
+static void copyFields(Record *r, const Record *values, int fields)
+{
+  if (fields & FIELD_NAME)
+    memcpy(r->name, values->name, sizeof(r->name));
+  if (fields & FIELD_SURNAME)
+    memcpy(r->surname, values->surname, sizeof(r->surname));
+  if (fields & FIELD_CITY)
+    memcpy(r->city, values->city, sizeof(r->city));
+}
+
+// copy the selected fields of values into the buffered records with its id, *changed of them
+static HT_ErrorCode updateBuffered(WriteBuffer* buffer, const Record *values, int fields, int *changed)
+{
+  *changed = 0;
+  unsigned i = tableHome(buffer, values->id);
+  for (int at; (at = tableNext(buffer, values->id, &i)) != -1; i = (i + 1) & buffer->tableMask) {
+    copyFields(&buffer->records[buffer->active][at], values, fields);
+    *changed += 1;
+  }
+  int first, end;
+  if (flushingRange(buffer, values->id, &first, &end) != HT_OK)
+    return HT_ERROR;
+  for (int at = first; at < end; at++) {
+    Record *r = &buffer->records[1 - buffer->active][at];
+    if (r->id == values->id) {
+      copyFields(r, values, fields);
+      *changed += 1;
+    }
+  }
+  return HT_OK;
+}
+
+// remove the buffered records with an id, *removed of them. The last record of the active half
+// fills the place of one removed, the half being written out keeps its order
+static HT_ErrorCode deleteBuffered(WriteBuffer* buffer, int id, int *removed)
+{
+  *removed = 0;
+  Record* records = buffer->records[buffer->active];
+  unsigned i = tableHome(buffer, id);
+  for (int at; (at = tableNext(buffer, id, &i)) != -1; i = tableHome(buffer, id)) {
+    int last = --buffer->count[buffer->active];
+    tableRemove(buffer, i);
+    if (at != last) {
+      unsigned moved = tableFind(buffer, last);
+      records[at] = records[last];
+      buffer->table[moved] = at + 1;
+    }
+    *removed += 1;
+  }
+  int first, end;
+  if (flushingRange(buffer, id, &first, &end) != HT_OK)
+    return HT_ERROR;
+  records = buffer->records[1 - buffer->active];
+  int kept = first;
+  for (int at = first; at < end; at++) {
+    if (records[at].id != id)
+      records[kept++] = records[at];
+  }
+  int count = buffer->count[1 - buffer->active];
+  memmove(&records[kept], &records[end], (count - end) * sizeof(Record));
+  buffer->count[1 - buffer->active] -= end - kept;
+  *removed += end - kept;
+  return HT_OK;
+}
+
+HT_ErrorCode HT_InsertEntry(int indexDesc, Record record)
+{
+  LOCK_BF();
+  long start = beginOp(METRIC_INSERT, indexDesc, record.id);
+  HT_ErrorCode code;
+  if ((indexDesc < MAX_OPEN_FILES) && (indexDesc > -1) && writeBuffers[indexDesc] != NULL)
+    code = bufferInsert(indexDesc, writeBuffers[indexDesc], record);
+  else
+    code = insertEntry(indexDesc, record);
+  if (code == HT_OK)
+    countRecords(indexDesc, 1);
+  endOp(start);
+  return code;
+}
+
+
+// copy the selected fields of values into the records of a chain with the same id. With append
+// a new id goes into the last block of the chain if it has space, all in one pin of every block.
+// The overflow blocks of an extendible bucket hold a single id, there only the first block takes it
+static HT_ErrorCode updateChain(int fileDesc, int bucketDesc, const Record *values, int fields,
+                                bool append, bool linear, UpdateResult *result)
+{
+  HANDLE(bucketBlock);
+  *result = NOT_FOUND;
+  for (int next = bucketDesc; next != -1;) {
+    int block = next;
+    CALL_BF(getBlock(fileDesc, block, bucketBlock));
+    Bucket *bucket = (Bucket *)BF_Block_GetData(bucketBlock);
+    bool dirty = false;
+    for (int i = 0; i < bucket->recordCount; i++) {
+      Record *r = &bucket->records[i];
+      if (r->id != values->id)
+        continue;
+      copyFields(r, values, fields);
+      *result = UPDATED;
+      dirty = true;
+    }
+    next = bucket->overflow;
+    if (next == -1 && append && *result == NOT_FOUND && bucket->recordCount < MAX_RECORDS &&
+        (linear || block == bucketDesc)) {
+      bucket->records[bucket->recordCount++] = *values;
+      *result = APPENDED;
+      dirty = true;
+    }
+    if (dirty)
+      BF_Block_SetDirty(bucketBlock);
+    CALL_BF(unpinBlock(bucketBlock));
+  }
+  return HT_OK;
+}
+
+static HT_ErrorCode upsert(int indexDesc, Record record)
+{
+  int fileDesc;
+  if ((indexDesc < MAX_OPEN_FILES) && (indexDesc > -1) && (indexTable.fileDesc[indexDesc] != -1))
+    fileDesc = indexTable.fileDesc[indexDesc];
+  else
+    return HT_ERROR;
+  WriteBuffer* buffer = writeBuffers[indexDesc];
+  int changed = 0;
+  if (buffer != NULL && updateBuffered(buffer, &record, FIELD_ALL, &changed) != HT_OK)
+    return HT_ERROR;
+
+  // copies of the id already written out are replaced too, a buffered one takes no new copy
+  if (!mayContain(indexDesc, record.id))
+    return changed > 0 ? HT_OK : HT_InsertEntry(indexDesc, record); // a new id, nothing to replace
+
+  HashInfo info;
+  if (readInfo(fileDesc, &info) != HT_OK)
+    return HT_ERROR;
+  int bucketDesc;
+  if (readSlot(fileDesc, &info, slotOf(&info, record.id), &bucketDesc) != HT_OK)
+    return HT_ERROR;
+
+  UpdateResult result = NOT_FOUND;
+  if (bucketDesc != -1 &&
+      updateChain(fileDesc, bucketDesc, &record, FIELD_ALL, changed == 0, info.mode == LINEAR, &result) != HT_OK)
+    return HT_ERROR;
+  if (result == UPDATED || changed > 0)
+    return HT_OK;
+  missedLookup(indexDesc);
+  if (result == APPENDED) { // the bucket had space, only linear hashing counts the records in the file
+    countRecords(indexDesc, 1);
+    if (bloomInsert(indexDesc, &info, record.id) != HT_OK)
+      return HT_ERROR;
+    return info.mode == LINEAR ? linearGrow(fileDesc, &info) : HT_OK;
+  }
+  return HT_InsertEntry(indexDesc, record); // a new bucket or a split is needed
+}
+
+HT_ErrorCode HT_Upsert(int indexDesc, Record record)
+{
+  LOCK_BF();
+  long start = beginOp(METRIC_INSERT, indexDesc, record.id);
+  HT_ErrorCode code = upsert(indexDesc, record);
+  endOp(start);
+  return code;
+}
+
+HT_ErrorCode HT_UpdateFields(int indexDesc, int id, int fields, const Record *values)
+{
+  LOCK_BF();
+  int fileDesc;
+  if ((indexDesc < MAX_OPEN_FILES) && (indexDesc > -1) && (indexTable.fileDesc[indexDesc] != -1))
+    fileDesc = indexTable.fileDesc[indexDesc];
+  else
+    return HT_ERROR;
+  WriteBuffer* buffer = writeBuffers[indexDesc];
+  int changed = 0;
+  Record key = *values;
+  key.id = id;
+  if (buffer != NULL && updateBuffered(buffer, &key, fields, &changed) != HT_OK)
+    return HT_ERROR;
+
+  // copies of the id already written out change too
+  if (!mayContain(indexDesc, id))
+    return changed > 0 ? HT_OK : HT_ERROR; // the id doesn't exist
+
+  HashInfo info;
+  if (readInfo(fileDesc, &info) != HT_OK)
+    return HT_ERROR;
+  int bucketDesc;
+  if (readSlot(fileDesc, &info, slotOf(&info, id), &bucketDesc) != HT_OK)
+    return HT_ERROR;
+  if (bucketDesc == -1) {
+    if (changed > 0)
+      return HT_OK;
+    missedLookup(indexDesc);
+    return HT_ERROR; // the id doesn't exist
+  }
+
+  UpdateResult result;
+  if (updateChain(fileDesc, bucketDesc, &key, fields, false, info.mode == LINEAR, &result) != HT_OK)
+    return HT_ERROR;
+  if (result == UPDATED || changed > 0)
+    return HT_OK;
+  missedLookup(indexDesc);
+  return HT_ERROR;
+}
+
+// halve the directory, the upper half only repeats the lower one
+static HT_ErrorCode halveHashTable(int fileDesc, HashInfo* info)
+{
+    if ((1 << (info->depth - 1)) >= MAX_BUCKETS) { // the last extent holds exactly the upper half
+        int segment = info->segments - 1;
+        for (int page = 0; page < pagesOf(segment); page++) {
+            if (freeBlock(fileDesc, info, info->segment[segment] + page) != HT_OK)
+                return HT_ERROR;
+        }
+        info->segments -= 1;
+    }
+    info->depth -= 1;
+    return HT_OK;
+}
+
+// rewrite a chain with the records left in it, the blocks it no longer needs are freed
+static HT_ErrorCode shrinkChain(int fileDesc, HashInfo* info, const int* chain, int chainSize,
+    const Record* records, int recordsSize, int localDepth)
+{
+    int needed = recordsSize == 0 ? 1 : (recordsSize + MAX_RECORDS - 1) / MAX_RECORDS;
+    if (writeChain(fileDesc, chain, needed, records, recordsSize, localDepth) != HT_OK)
+        return HT_ERROR;
+    for (int i = needed; i < chainSize; i++) {
+        if (freeBlock(fileDesc, info, chain[i]) != HT_OK)
+            return HT_ERROR;
+    }
+    return HT_OK;
+}
+
+// linear hashing, undo the last split: the last bucket goes back into the one it came from
+static HT_ErrorCode linearMerge(int fileDesc, HashInfo* info)
+{
+    if (info->splitPointer == 0) { // back to the previous round
+        info->depth -= 1;
+        info->splitPointer = 1 << info->depth;
+    }
+    info->splitPointer -= 1;
+    int to = info->splitPointer;
+    int from = (1 << info->depth) + to;
+
+    int toDesc, fromDesc;
+    if (readSlot(fileDesc, info, to, &toDesc) != HT_OK ||
+            readSlot(fileDesc, info, from, &fromDesc) != HT_OK)
+        return HT_ERROR;
+    if (fromDesc != -1) {
+        Chain* chain = &chainBuffer; // both chains one after the other
+        chain->blockCount = chain->recordCount = 0;
+        if ((toDesc != -1 && gatherChain(fileDesc, toDesc, chain) != HT_OK) ||
+                gatherChain(fileDesc, fromDesc, chain) != HT_OK)
+            return HT_ERROR;
+        if (shrinkChain(fileDesc, info, chain->blocks, chain->blockCount, chain->records, chain->recordCount, info->depth) != HT_OK ||
+                (toDesc == -1 && writeSlot(fileDesc, info, to, chain->blocks[0]) != HT_OK) ||
+                writeSlot(fileDesc, info, from, -1) != HT_OK)
+            return HT_ERROR;
+    }
+
+    // the last extent of the directory is freed once none of its slots is in use
+    if (info->segments > 1 && from == pagesOf(info->segments - 1) * MAX_BUCKETS) {
+        int segment = info->segments - 1;
+        for (int page = 0; page < pagesOf(segment); page++) {
+            if (freeBlock(fileDesc, info, info->segment[segment] + page) != HT_OK)
+                return HT_ERROR;
+        }
+        info->segments -= 1;
+    }
+    return HT_OK;
+}
+
+// linear hashing delete, the chain is compacted and the file contracts when it gets too empty
+static HT_ErrorCode linearDelete(int fileDesc, HashInfo* info, int slot, int id, bool* found)
+{
+    int bucketDesc;
+    *found = false;
+    if (readSlot(fileDesc, info, slot, &bucketDesc) != HT_OK)
+        return HT_ERROR;
+    if (bucketDesc == -1)
+        return HT_OK;
+
+    Chain* chain = &chainBuffer;
+    chain->blockCount = chain->recordCount = 0;
+    if (gatherChain(fileDesc, bucketDesc, chain) != HT_OK)
+        return HT_ERROR;
+    int kept = 0;
+    for (int i = 0; i < chain->recordCount; i++) {
+        if (chain->records[i].id != id)
+            chain->records[kept++] = chain->records[i];
+    }
+    int deleted = chain->recordCount - kept;
+    if (deleted == 0)
+        return HT_OK;
+    *found = true;
+    if (kept == 0) { // nothing left, the slot goes back to empty
+        for (int i = 0; i < chain->blockCount; i++) {
+            if (freeBlock(fileDesc, info, chain->blocks[i]) != HT_OK)
+                return HT_ERROR;
+        }
+        if (writeSlot(fileDesc, info, slot, -1) != HT_OK)
+            return HT_ERROR;
+    }
+    else if (shrinkChain(fileDesc, info, chain->blocks, chain->blockCount, chain->records, kept, chain->localDepth) != HT_OK)
+        return HT_ERROR;
+
+    info->recordCount -= deleted;
+    long long capacity = (long long)((1 << info->depth) + info->splitPointer) * MAX_RECORDS;
+    while ((long long)info->recordCount * 100 < capacity * MIN_LOAD && (info->depth > 1 || info->splitPointer > 0)) {
+        if (linearMerge(fileDesc, info) != HT_OK)
+            return HT_ERROR;
+        capacity = (long long)((1 << info->depth) + info->splitPointer) * MAX_RECORDS;
+    }
+    return writeInfo(fileDesc, info);
+}
+
+// delete the records with an id from the file, *found is false if it has none
+static HT_ErrorCode deleteEntry(int indexDesc, int id, bool* found)
+{
+    int fileDesc = indexTable.fileDesc[indexDesc];
+    HashInfo info;
+    *found = false;
+    if (readInfo(fileDesc, &info) != HT_OK)
+        return HT_ERROR;
+    int slot = slotOf(&info, id);
+    if (info.mode == LINEAR)
+        return linearDelete(fileDesc, &info, slot, id, found);
+
+    int bucketDesc;
+    if (readSlot(fileDesc, &info, slot, &bucketDesc) != HT_OK)
+        return HT_ERROR;
+    if (bucketDesc == -1)
+        return HT_OK;
+
+    // compact the bucket in place
+    HANDLE(bucketBlock);
+    CALL_BF(getBlock(fileDesc, bucketDesc, bucketBlock));
+    Bucket* bucket = (Bucket*)BF_Block_GetData(bucketBlock);
+    int kept = 0;
+    for (int i = 0; i < bucket->recordCount; i++) {
+        if (bucket->records[i].id != id)
+            bucket->records[kept++] = bucket->records[i];
+    }
+    int deleted = bucket->recordCount - kept;
+    bucket->recordCount = kept;
+    int localDepth = bucket->localDepth;
+    int overflow = deleted != 0 ? bucket->overflow : -1;
+    if (deleted != 0) {
+        bucket->overflow = -1;
+        BF_Block_SetDirty(bucketBlock);
+    }
+    CALL_BF(unpinBlock(bucketBlock));
+    if (deleted == 0) {
+        return HT_OK;
+    }
+    *found = true;
+    while (overflow != -1) { // the overflow blocks only hold more records with this id
+        CALL_BF(getBlock(fileDesc, overflow, bucketBlock));
+        int next = ((Bucket*)BF_Block_GetData(bucketBlock))->overflow;
+        deleted += ((Bucket*)BF_Block_GetData(bucketBlock))->recordCount;
+        CALL_BF(unpinBlock(bucketBlock));
+        if (freeBlock(fileDesc, &info, overflow) != HT_OK)
+            return HT_ERROR;
+        overflow = next;
+    }
+    countRecords(indexDesc, -deleted);
+
+    // merge with the buddy while both fit in one page
+    HANDLE(buddyBlock);
+    while (localDepth > 0) {
+        int half = 1 << (localDepth - 1);
+        int buddy = (slot ^ half) & ((1 << localDepth) - 1);
+        int buddyDesc;
+        if (readSlot(fileDesc, &info, buddy, &buddyDesc) != HT_OK)
+            return HT_ERROR;
+
+        if (buddyDesc == -1) { // the buddy can only be merged if none of its slots has a bucket
+            bool empty;
+            if (emptySlots(fileDesc, &info, buddy, 1 << localDepth, &empty) != HT_OK)
+                return HT_ERROR;
+            if (!empty)
+                break;
+            info.depthCount[localDepth] -= 1;
+        }
+        else {
+            CALL_BF(getBlock(fileDesc, buddyDesc, buddyBlock));
+            Bucket* buddyBucket = (Bucket*)BF_Block_GetData(buddyBlock);
+            if (buddyBucket->localDepth != localDepth || buddyBucket->overflow != -1 ||
+                    buddyBucket->recordCount + kept > MAX_RECORDS) {
+                CALL_BF(unpinBlock(buddyBlock));
+                break;
+            }
+            CALL_BF(getBlock(fileDesc, bucketDesc, bucketBlock));
+            bucket = (Bucket*)BF_Block_GetData(bucketBlock);
+            memcpy(&bucket->records[kept], buddyBucket->records, buddyBucket->recordCount * sizeof(Record));
+            kept += buddyBucket->recordCount;
+            bucket->recordCount = kept;
+            BF_Block_SetDirty(bucketBlock);
+            CALL_BF(unpinBlock(bucketBlock));
+            CALL_BF(unpinBlock(buddyBlock));
+            if (freeBlock(fileDesc, &info, buddyDesc) != HT_OK)
+                return HT_ERROR;
+            info.depthCount[localDepth] -= 2;
+        }
+
+        // the slots of the buddy now point to the merged bucket, one bit less decides
+        if (pointSlots(fileDesc, &info, buddy, 1 << localDepth, bucketDesc) != HT_OK)
+            return HT_ERROR;
+        localDepth -= 1;
+        info.depthCount[localDepth] += 1;
+        CALL_BF(getBlock(fileDesc, bucketDesc, bucketBlock));
+        ((Bucket*)BF_Block_GetData(bucketBlock))->localDepth = localDepth;
+        BF_Block_SetDirty(bucketBlock);
+        CALL_BF(unpinBlock(bucketBlock));
+    }
+
+    if (kept == 0) { // nothing left, its slots go back to empty
+        if (pointSlots(fileDesc, &info, slot & ((1 << localDepth) - 1), 1 << localDepth, -1) != HT_OK ||
+                freeBlock(fileDesc, &info, bucketDesc) != HT_OK)
+            return HT_ERROR;
+        info.depthCount[localDepth] -= 1;
+    }
+
+    // halve the directory while no bucket needs the full global depth
+    while (info.depth > 1 && info.depthCount[info.depth] == 0) {
+        if (halveHashTable(fileDesc, &info) != HT_OK)
+            return HT_ERROR;
+    }
+    return writeInfo(fileDesc, &info);
+}
+
+HT_ErrorCode HT_DeleteEntry(int indexDesc, int id)
+{
+    LOCK_BF();
+    if ((indexDesc >= MAX_OPEN_FILES) || (indexDesc < 0) || (indexTable.fileDesc[indexDesc] == -1))
+        return HT_ERROR;
+
+    // every copy of the id goes, the ones still in memory and any older ones already in the file
+    int buffered = 0;
+    if (writeBuffers[indexDesc] != NULL && deleteBuffered(writeBuffers[indexDesc], id, &buffered) != HT_OK)
+        return HT_ERROR;
+    countRecords(indexDesc, -buffered);
+    bool found = false;
+    if (mayContain(indexDesc, id) && deleteEntry(indexDesc, id, &found) != HT_OK)
+        return HT_ERROR;
+    return found || buffered > 0 ? HT_OK : HT_ERROR; // HT_ERROR if the id doesn't exist
+}
+
+// print the records with an id that are still in the write buffer of the index, *found if there were any
+static HT_ErrorCode printBuffered(int indexDesc, int id, bool* found)
+{
+    WriteBuffer* buffer = writeBuffers[indexDesc];
+    *found = false;
+    if (buffer == NULL)
+        return HT_OK;
+    const Record* records = buffer->records[buffer->active];
+    unsigned i = tableHome(buffer, id);
+    for (int at; (at = tableNext(buffer, id, &i)) != -1; i = (i + 1) & buffer->tableMask) {
+        printf("ID: %d, name: %s, surname: %s, city: %s\n", id, records[at].name, records[at].surname, records[at].city);
+        *found = true;
+    }
+    int first, end;
+    if (flushingRange(buffer, id, &first, &end) != HT_OK)
+        return HT_ERROR;
+    records = buffer->records[1 - buffer->active];
+    for (int at = first; at < end; at++) {
+        if (records[at].id == id) {
+            printf("ID: %d, name: %s, surname: %s, city: %s\n", id, records[at].name, records[at].surname, records[at].city);
+            *found = true;
+        }
+    }
+    return HT_OK;
+}
+
+static HT_ErrorCode printEntries(int indexDesc, int* id)
+{
+
+    int fileDesc;
+    if ((indexDesc < MAX_OPEN_FILES) && (indexDesc > -1) && (indexTable.fileDesc[indexDesc] != -1)) {
+        fileDesc = indexTable.fileDesc[indexDesc];
+    } else return HT_ERROR;
+
+    HashInfo info;
+    if (readInfo(fileDesc, &info) != HT_OK)
+        return HT_ERROR;
+
+    if (id != NULL) {
+        if (!mayContain(indexDesc, *id)) {
+            printf("ID doesn't exist\n");
+            return HT_OK;
+        }
+        bool found;
+        if (printBuffered(indexDesc, *id, &found) != HT_OK)
+            return HT_ERROR;
+        int whichfblock;
+        current.slot = slotOf(&info, *id);
+        current.depth = info.depth;
+        if (readSlot(fileDesc, &info, current.slot, &whichfblock) != HT_OK)
+            return HT_ERROR;
+        current.block = whichfblock;
+        if (whichfblock == -1) {
+            if (!found) {
+                missedLookup(indexDesc);
+                printf("ID doesn't exist\n");
+            }
+            return HT_OK;
+        }
+        HANDLE(bucket);
+        while (whichfblock != -1) { // the bucket and its overflow blocks
+            CALL_BF(getBlock(fileDesc, whichfblock, bucket));
+            char* data = BF_Block_GetData(bucket);
+            for (int i = 0; i < ((Bucket*)data)->recordCount; i++) {
+                Record r = ((Bucket*)data)->records[i];
+                if (r.id == *id) {
+                    printf("ID: %d, name: %s, surname: %s, city: %s\n", r.id, r.name,
+                        r.surname, r.city);
+                    found = true;
+                }
+            }
+            whichfblock = ((Bucket*)data)->overflow;
+            unpinBlock(bucket);
+        }
+        if (!found)
+            missedLookup(indexDesc);
+    } else {
+        int howManyBlocks;
+        BF_GetBlockCounter(fileDesc, &howManyBlocks);
+        HANDLE(bucketBlock);
+        for (int i = 0; i < howManyBlocks; i++) {
+            if (!isDirectoryBlock(&info, i)) { //if not hash block
+                CALL_BF(getBlock(fileDesc, i, bucketBlock));
+                char* bucket = BF_Block_GetData(bucketBlock);
+                for (int j = 0; j < ((Bucket*)bucket)->recordCount; j++) {
+                    Record r = ((Bucket*)bucket)->records[j];
+                    printf("ID: %d, name: %s, surname: %s, city: %s\n", r.id, r.name,
+                        r.surname, r.city);
+                }
+                unpinBlock(bucketBlock);
+            }
+        }
+    }
+    return HT_OK;
+}
+
+HT_ErrorCode HT_PrintAllEntries(int indexDesc, int* id)
+{
+    LOCK_BF();
+    if (id == NULL && (indexDesc < MAX_OPEN_FILES) && (indexDesc > -1) && drainBuffer(indexDesc) != HT_OK)
+        return HT_ERROR;
+    long start = beginOp(id == NULL ? METRIC_SCAN : METRIC_LOOKUP, indexDesc, id == NULL ? 0 : *id);
+    HT_ErrorCode code = printEntries(indexDesc, id);
+    endOp(start);
+    return code;
+}
+
+// number of slots of the directory in use
+static int slotCount(const HashInfo* info)
+{
+    return (1 << info->depth) + (info->mode == LINEAR ? info->splitPointer : 0);
+}
+
+// the distinct buckets of the slots group, group + 2^depth, ... of a file, sorted
+static HT_ErrorCode groupBuckets(int fileDesc, const HashInfo* info, int group, int depth, int* buckets, int* count)
+{
+    *count = 0;
+    for (int s = group; s < slotCount(info); s += 1 << depth) {
+        int bucketDesc;
+        if (readSlot(fileDesc, info, s, &bucketDesc) != HT_OK)
+            return HT_ERROR;
+        if (bucketDesc == -1)
+            continue;
+        int i = *count; // insertion sort, a group has few buckets
+        while (i > 0 && buckets[i - 1] > bucketDesc)
+            i--;
+        if (i > 0 && buckets[i - 1] == bucketDesc)
+            continue;
+        memmove(&buckets[i + 1], &buckets[i], (*count - i) * sizeof(int));
+        buckets[i] = bucketDesc;
+        *count += 1;
+    }
+    return HT_OK;
+}
+
+static unsigned joinHash(int id, int bits)
+{
+    return bits == 0 ? 0 : ((unsigned)id * 2654435761u) >> (32 - bits);
+}
+
+HT_ErrorCode HT_Join(int indexA, int indexB, HT_JoinCallback callback, void* ctx)
+{
+    LOCK_BF();
+    int fileDesc[2];
+    int indexDesc[2] = { indexA, indexB };
+    for (int f = 0; f < 2; f++) {
+        if ((indexDesc[f] < MAX_OPEN_FILES) && (indexDesc[f] > -1) && (indexTable.fileDesc[indexDesc[f]] != -1))
+            fileDesc[f] = indexTable.fileDesc[indexDesc[f]];
+        else
+            return HT_ERROR;
+        if (drainBuffer(indexDesc[f]) != HT_OK)
+            return HT_ERROR;
+    }
+    if (callback == NULL)
+        return HT_ERROR;
+
+    HashInfo info[2];
+    if (readInfo(fileDesc[0], &info[0]) != HT_OK || readInfo(fileDesc[1], &info[1]) != HT_OK)
+        return HT_ERROR;
+
+    // the records of both files with the same low depth bits are in the slots with those bits, so
+    // at the common depth every group of slots is joined on its own. The file with the smaller
+    // depth has about one bucket per group and is built into the table, the other one probes it
+    int depth = info[0].depth < info[1].depth ? info[0].depth : info[1].depth;
+    int build = info[0].depth <= info[1].depth ? 0 : 1;
+    int probe = 1 - build;
+    int* buckets = malloc(((1 << (info[probe].depth - depth)) * 2 + 2) * sizeof(int));
+    if (buckets == NULL)
+        return HT_ERROR;
+    Record* records = NULL;
+    int recordCapacity = 0;
+    int* table = NULL;
+    int tableBits = -1;
+    HANDLE(bucketBlock);
+    HT_ErrorCode result = HT_OK;
+
+    for (int group = 0; group < (1 << depth) && result == HT_OK; group++) {
+        // build: the records of the group in the smaller file
+        int count, recordCount = 0;
+        if (groupBuckets(fileDesc[build], &info[build], group, depth, buckets, &count) != HT_OK) {
+            result = HT_ERROR;
+            break;
+        }
+        for (int b = 0; b < count && result == HT_OK; b++) {
+            for (int next = buckets[b]; next != -1;) {
+                if (getBlock(fileDesc[build], next, bucketBlock) != BF_OK) {
+                    result = HT_ERROR;
+                    break;
+                }
+                Bucket* bucket = (Bucket*)BF_Block_GetData(bucketBlock);
+                if (recordCount + MAX_RECORDS > recordCapacity) {
+                    int capacity = recordCapacity == 0 ? 16 * MAX_RECORDS : recordCapacity * 2;
+                    Record* grown = realloc(records, capacity * sizeof(Record));
+                    if (grown == NULL) {
+                        unpinBlock(bucketBlock);
+                        result = HT_ERROR;
+                        break;
+                    }
+                    records = grown;
+                    recordCapacity = capacity;
+                }
+                for (int i = 0; i < bucket->recordCount; i++) {
+                    if (hashFunction(bucket->records[i].id, depth) == group) // a bucket of a smaller local depth is shared
+                        records[recordCount++] = bucket->records[i];
+                }
+                next = bucket->overflow;
+                unpinBlock(bucketBlock);
+            }
+        }
+        if (recordCount == 0 || result != HT_OK)
+            continue;
+
+        int bits = 1;
+        while ((1 << bits) < recordCount * 2)
+            bits++;
+        if (bits > tableBits) {
+            int* grown = realloc(table, (1 << bits) * sizeof(int));
+            if (grown == NULL) {
+                result = HT_ERROR;
+                break;
+            }
+            table = grown;
+            tableBits = bits;
+        }
+        int mask = (1 << bits) - 1;
+        memset(table, -1, (1 << bits) * sizeof(int));
+        for (int i = 0; i < recordCount; i++) {
+            unsigned h = joinHash(records[i].id, bits);
+            while (table[h] != -1)
+                h = (h + 1) & mask;
+            table[h] = i;
+        }
+
+        // probe: the buckets of the same group in the other file, every page read once
+        if (groupBuckets(fileDesc[probe], &info[probe], group, depth, buckets, &count) != HT_OK) {
+            result = HT_ERROR;
+            break;
+        }
+        for (int b = 0; b < count && result == HT_OK; b++) {
+            for (int next = buckets[b]; next != -1;) {
+                if (getBlock(fileDesc[probe], next, bucketBlock) != BF_OK) {
+                    result = HT_ERROR;
+                    break;
+                }
+                Bucket* bucket = (Bucket*)BF_Block_GetData(bucketBlock);
+                for (int i = 0; i < bucket->recordCount; i++) {
+                    const Record* r = &bucket->records[i];
+                    for (unsigned h = joinHash(r->id, bits); table[h] != -1; h = (h + 1) & mask) {
+                        if (records[table[h]].id != r->id)
+                            continue;
+                        if (build == 0)
+                            callback(&records[table[h]], r, ctx);
+                        else
+                            callback(r, &records[table[h]], ctx);
+                    }
+                }
+                next = bucket->overflow;
+                unpinBlock(bucketBlock);
+            }
+        }
+    }
+
+    free(buckets);
+    free(records);
+    free(table);
+    return result;
+}
+
+static HT_ErrorCode scanPages(int indexDesc, HT_PageCallback callback, void* ctx)
+{
+    int fileDesc;
+    if ((indexDesc < MAX_OPEN_FILES) && (indexDesc > -1) && (indexTable.fileDesc[indexDesc] != -1))
+        fileDesc = indexTable.fileDesc[indexDesc];
+    else
+        return HT_ERROR;
+    if (callback == NULL)
+        return HT_ERROR;
+
+    HashInfo info;
+    if (readInfo(fileDesc, &info) != HT_OK)
+        return HT_ERROR;
+    int blocks;
+    CALL_BF(BF_GetBlockCounter(fileDesc, &blocks));
+    HANDLE(bucketBlock);
+    for (int i = 0; i < blocks; i++) {
+        if (isDirectoryBlock(&info, i))
+            continue;
+        CALL_BF(getBlock(fileDesc, i, bucketBlock));
+        const Bucket* bucket = (const Bucket*)BF_Block_GetData(bucketBlock);
+        if (bucket->localDepth != FREE_BLOCK && bucket->recordCount > 0)
+            callback(bucket->records, bucket->recordCount, ctx);
+        CALL_BF(unpinBlock(bucketBlock));
+    }
+    return HT_OK;
+}
+
+HT_ErrorCode HT_ScanPages(int indexDesc, HT_PageCallback callback, void* ctx)
+{
+    LOCK_BF();
+    if ((indexDesc < MAX_OPEN_FILES) && (indexDesc > -1) && drainBuffer(indexDesc) != HT_OK)
+        return HT_ERROR;
+    long start = beginOp(METRIC_SCAN, indexDesc, 0);
+    HT_ErrorCode code = scanPages(indexDesc, callback, ctx);
+    endOp(start);
+    return code;
+}
+
+HT_ErrorCode HT_GetStatistics(int indexDesc, HT_Statistics* stats)
+{
+    LOCK_BF();
+    int fileDesc;
+    if ((indexDesc < MAX_OPEN_FILES) && (indexDesc > -1) && (indexTable.fileDesc[indexDesc] != -1)) {
+        fileDesc = indexTable.fileDesc[indexDesc];
+    } else
+        return HT_ERROR;
+    if (drainBuffer(indexDesc) != HT_OK)
+        return HT_ERROR;
+
+    HashInfo info;
+    if (readInfo(fileDesc, &info) != HT_OK)
+        return HT_ERROR;
+
+    // compute the number of blocks in the file
+    CALL_BF(BF_GetBlockCounter(fileDesc, &stats->blocks));
+    stats->reservedBlocks = indexTable.reservedEnd[indexDesc] > stats->blocks ? indexTable.reservedEnd[indexDesc] - stats->blocks : 0;
+    stats->buckets = 0; // counter for buckets
+    stats->freeBlocks = 0; // counter for blocks waiting to be reused
+    stats->records = 0; // counter for records
+    stats->minRecords = MAX_RECORDS + 1; // max records + 1
+    stats->maxRecords = 0; // min records per bucket - 1
+
+    char* data;
+    HANDLE(bucketBlock);
+
+    for (int i = 0; i < stats->blocks; i++) {
+        if (!isDirectoryBlock(&info, i)) //if not hash block
+        {
+            CALL_BF(getBlock(fileDesc, i, bucketBlock));
+            data = BF_Block_GetData(bucketBlock);
+            if (((Bucket*)data)->localDepth == FREE_BLOCK) { // on the reuse list
+                stats->freeBlocks++;
+                unpinBlock(bucketBlock);
+                continue;
+            }
+
+            if (((Bucket*)data)->recordCount > stats->maxRecords)
+                stats->maxRecords = ((Bucket*)data)->recordCount;
+
+            if (((Bucket*)data)->recordCount < stats->minRecords)
+                stats->minRecords = ((Bucket*)data)->recordCount;
+
+            stats->records += ((Bucket*)data)->recordCount;
+            stats->buckets++;
+            unpinBlock(bucketBlock);
+        }
+    }
+
+    if (stats->buckets == 0)
+        stats->minRecords = 0;
+    indexTable.records[indexDesc] = stats->records; // the write buffer was drained
+
+    // a missing id passes when all its probes hit set bits of its block
+    const BloomFilter* bloom = &indexTable.bloom[indexDesc];
+    stats->bloomBytes = bloom->blockCount * BLOOM_WORDS * (int)sizeof(unsigned long long);
+    stats->bloomKeys = bloom->keys;
+    stats->bloomFalsePositive = 0;
+    stats->bloomNegatives = bloom->negatives;
+    stats->bloomFalsePositives = bloom->falsePositives;
+    for (int b = 0; b < bloom->blockCount; b++) {
+        int set = 0;
+        for (int w = 0; w < BLOOM_WORDS; w++)
+            set += __builtin_popcountll(bloom->bits[b * BLOOM_WORDS + w]);
+        stats->bloomFalsePositive += pow((double)set / BLOOM_BLOCK_BITS, bloom->probes);
+    }
+    if (bloom->blockCount > 0)
+        stats->bloomFalsePositive /= bloom->blockCount;
+    return HT_OK;
+}
+
+typedef struct CompactBucket{ // a bucket of a file being compacted
+    int pattern;    // the low bits its ids share, also its first slot
+    int localDepth;
+    int records;
+    int firstSource; // blocks of the old file it takes the records of, chained through sourceNext
+    int lastSource;
+    bool chained;   // overflow blocks or linear hashing, kept as it is
+    bool dropped;   // empty, or merged into its buddy
+    int newBlock;
+} CompactBucket;
+
+// read all the slots of the directory, the extents may be anywhere in the file
+static HT_ErrorCode readDirectory(int fileDesc, const HashInfo* info, int slots, int* directory)
+{
+    HANDLE(hashBlock);
+    for (int first = 0; first < slots; first += MAX_BUCKETS) {
+        CALL_BF(getBlock(fileDesc, pageBlock(info, first), hashBlock));
+        int count = slots - first < MAX_BUCKETS ? slots - first : MAX_BUCKETS;
+        memcpy(&directory[first], ((HashTable*)BF_Block_GetData(hashBlock))->buckets, count * sizeof(int));
+        CALL_BF(unpinBlock(hashBlock));
+    }
+    return HT_OK;
+}
+
+// one bucket for every distinct block of the directory, which then holds bucket numbers
+static HT_ErrorCode collectBuckets(int fileDesc, const HashInfo* info, int slots, int* directory, int blocks,
+    CompactBucket* buckets, int* count, int* sourceNext)
+{
+    int* bucketOf = malloc(blocks * sizeof(int));
+    for (int i = 0; i < blocks; i++)
+        bucketOf[i] = -1;
+    HANDLE(bucketBlock);
+    *count = 0;
+    for (int s = 0; s < slots; s++) {
+        int block = directory[s];
+        if (block == -1)
+            continue;
+        if (block <= 0 || block >= blocks) {
+            free(bucketOf);
+            return HT_ERROR;
+        }
+        if (bucketOf[block] == -1) {
+            CALL_BF(getBlock(fileDesc, block, bucketBlock));
+            Bucket* bucket = (Bucket*)BF_Block_GetData(bucketBlock);
+            CompactBucket* b = &buckets[*count];
+            b->localDepth = bucket->localDepth;
+            b->pattern = info->mode == LINEAR ? s : s & ((1 << bucket->localDepth) - 1);
+            b->records = bucket->recordCount;
+            b->chained = info->mode == LINEAR || bucket->overflow != -1;
+            b->dropped = false;
+            b->firstSource = b->lastSource = block;
+            sourceNext[block] = -1;
+            CALL_BF(unpinBlock(bucketBlock));
+            bucketOf[block] = (*count)++;
+        }
+        directory[s] = bucketOf[block];
+    }
+    free(bucketOf);
+    return HT_OK;
+}
+
+// drop the empty buckets and merge buddies while both fit in one, as a delete does
+static void mergeBuckets(int depth, int* directory, CompactBucket* buckets, int count, int* sourceNext)
+{
+    for (int b = 0; b < count; b++) {
+        if (buckets[b].records == 0 && !buckets[b].chained) {
+            for (int s = buckets[b].pattern; s < (1 << depth); s += 1 << buckets[b].localDepth)
+                directory[s] = -1;
+            buckets[b].dropped = true;
+        }
+    }
+    for (bool merged = true; merged;) {
+        merged = false;
+        for (int b = 0; b < count; b++) {
+            CompactBucket* bucket = &buckets[b];
+            while (!bucket->dropped && !bucket->chained && bucket->localDepth > 0) {
+                int localDepth = bucket->localDepth;
+                int buddy = bucket->pattern ^ (1 << (localDepth - 1));
+                int other = directory[buddy];
+                if (other == -1) { // the buddy can only be merged if none of its slots has a bucket
+                    bool empty = true;
+                    for (int s = buddy; s < (1 << depth) && empty; s += 1 << localDepth)
+                        empty = directory[s] == -1;
+                    if (!empty)
+                        break;
+                }
+                else {
+                    CompactBucket* buddyBucket = &buckets[other];
+                    if (buddyBucket->localDepth != localDepth || buddyBucket->chained ||
+                            buddyBucket->records + bucket->records > MAX_RECORDS)
+                        break;
+                    bucket->records += buddyBucket->records;
+                    sourceNext[bucket->lastSource] = buddyBucket->firstSource;
+                    bucket->lastSource = buddyBucket->lastSource;
+                    buddyBucket->dropped = true;
+                }
+                for (int s = buddy; s < (1 << depth); s += 1 << localDepth)
+                    directory[s] = b;
+                bucket->localDepth = localDepth - 1;
+                bucket->pattern &= (1 << (localDepth - 1)) - 1;
+                merged = true;
+            }
+        }
+    }
+}
+
+// write the compacted file: the first block, the directory pages one after the other, then the
+// buckets in the order of their first slot with their records packed
+static HT_ErrorCode writeCompact(int fileDesc, const HashInfo* info, int slots, const int* directory,
+    CompactBucket* buckets, const int* sourceNext, const char* outFile)
+{
+    int outDesc;
+    CALL_BF(BF_CreateFile(outFile));
+    CALL_BF(BF_OpenFile(outFile, &outDesc));
+    HANDLE(block);
+    for (int page = 0; page <= pagesOf(info->segments); page++) { // the first block and the directory
+        CALL_BF(allocBlock(outDesc, block));
+        CALL_BF(unpinBlock(block));
+    }
+
+    Chain gather = { 0 }, written = { 0 };
+    HT_ErrorCode code = HT_OK;
+    for (int s = 0; s < slots && code == HT_OK; s++) {
+        if (directory[s] == -1 || buckets[directory[s]].pattern != s)
+            continue; // empty, or not the first slot of its bucket
+        CompactBucket* bucket = &buckets[directory[s]];
+        gather.blockCount = gather.recordCount = 0;
+        for (int source = bucket->firstSource; source != -1 && code == HT_OK; source = sourceNext[source])
+            code = gatherChain(fileDesc, source, &gather);
+        int blockCount = gather.recordCount == 0 ? 1 : (gather.recordCount + MAX_RECORDS - 1) / MAX_RECORDS;
+        written.blockCount = 0;
+        for (int i = 0; i < blockCount && code == HT_OK; i++) {
+            int next;
+            if (allocBlock(outDesc, block) != BF_OK || unpinBlock(block) != BF_OK ||
+                    BF_GetBlockCounter(outDesc, &next) != BF_OK)
+                code = HT_ERROR;
+            else
+                appendBlock(&written, next - 1);
+        }
+        if (code == HT_OK) {
+            bucket->newBlock = written.blocks[0];
+            code = writeChain(outDesc, written.blocks, blockCount, gather.records, gather.recordCount,
+                info->mode == LINEAR ? gather.localDepth : bucket->localDepth);
+        }
+    }
+    free(gather.blocks);
+    free(gather.records);
+    free(written.blocks);
+    if (code != HT_OK)
+        return HT_ERROR;
+
+    for (int page = 0; page < pagesOf(info->segments); page++) {
+        CALL_BF(getBlock(outDesc, pageBlock(info, page * MAX_BUCKETS), block));
+        HashTable* table = (HashTable*)BF_Block_GetData(block);
+        for (int i = 0; i < MAX_BUCKETS; i++) {
+            int s = page * MAX_BUCKETS + i;
+            table->buckets[i] = s >= slots || directory[s] == -1 ? -1 : buckets[directory[s]].newBlock;
+        }
+        BF_Block_SetDirty(block);
+        CALL_BF(unpinBlock(block));
+    }
+    CALL_BF(getBlock(outDesc, 0, block));
+    memcpy(BF_Block_GetData(block), info, sizeof(HashInfo));
+    BF_Block_SetDirty(block);
+    CALL_BF(unpinBlock(block));
+    CALL_BF(BF_CloseFile(outDesc));
+
+    int fd = open(outFile, O_RDWR); // on the disk before it replaces the old file
+    bool synced = fd != -1 && fsync(fd) == 0;
+    if (fd != -1)
+        close(fd);
+    return synced ? HT_OK : HT_ERROR;
+}
+
+HT_ErrorCode HT_Compact(int indexDesc)
+{
+    LOCK_BF();
+    int fileDesc;
+    if ((indexDesc < MAX_OPEN_FILES) && (indexDesc > -1) && (indexTable.fileDesc[indexDesc] != -1))
+        fileDesc = indexTable.fileDesc[indexDesc];
+    else
+        return HT_ERROR;
+    if (drainBuffer(indexDesc) != HT_OK)
+        return HT_ERROR;
+
+    HashInfo info;
+    int blocks;
+    if (readInfo(fileDesc, &info) != HT_OK)
+        return HT_ERROR;
+    CALL_BF(BF_GetBlockCounter(fileDesc, &blocks));
+    int slots = slotCount(&info);
+    int* directory = malloc(slots * sizeof(int));
+    int* sourceNext = malloc(blocks * sizeof(int));
+    CompactBucket* buckets = malloc(blocks * sizeof(CompactBucket));
+    int count;
+    HT_ErrorCode code = directory != NULL && sourceNext != NULL && buckets != NULL ? HT_OK : HT_ERROR;
+    if (code == HT_OK)
+        code = readDirectory(fileDesc, &info, slots, directory);
+    if (code == HT_OK)
+        code = collectBuckets(fileDesc, &info, slots, directory, blocks, buckets, &count, sourceNext);
+
+    // the new layout: the directory right after the first block, just as large as it needs to be
+    HashInfo compact = info;
+    if (code == HT_OK && info.mode == EXTENDIBLE) {
+        mergeBuckets(info.depth, directory, buckets, count, sourceNext);
+        memset(compact.depthCount, 0, sizeof(compact.depthCount));
+        for (int b = 0; b < count; b++) {
+            if (!buckets[b].dropped)
+                compact.depthCount[buckets[b].localDepth] += 1;
+        }
+        // the upper half of the directory only repeats the lower one while no bucket needs the full depth
+        while (compact.depth > 1 && compact.depthCount[compact.depth] == 0)
+            compact.depth -= 1;
+        slots = 1 << compact.depth;
+        compact.segments = 0;
+        while (pagesOf(compact.segments) * MAX_BUCKETS < slots)
+            compact.segments++;
+    }
+    for (int i = 0; i < compact.segments; i++)
+        compact.segment[i] = 1 + pagesOf(i);
+    compact.freeList = -1;
+    compact.freeBlocks = 0;
+
+    char fileName[MAX_FILE_NAME], outFile[MAX_FILE_NAME + 8];
+    strcpy(fileName, indexTable.fileName[indexDesc]);
+    snprintf(outFile, sizeof(outFile), "%s.compact", fileName);
+    unlink(outFile); // left by a compaction that did not finish
+    if (code == HT_OK)
+        code = writeCompact(fileDesc, &compact, slots, directory, buckets, sourceNext, outFile);
+    free(directory);
+    free(sourceNext);
+    free(buckets);
+    if (code != HT_OK) {
+        unlink(outFile);
+        return HT_ERROR;
+    }
+
+    // the new file replaces the old one in a single rename and opens in the same entry of the
+    // index table, with the write buffer and extent size it had
+    int bufferRecords = writeBuffers[indexDesc] != NULL ? writeBuffers[indexDesc]->capacity : 0;
+    int extentBlocks = indexTable.extentBlocks[indexDesc];
+    if (HT_CloseFile(indexDesc) != HT_OK) {
+        unlink(outFile);
+        return HT_ERROR;
+    }
+    code = rename(outFile, fileName) == 0 ? HT_OK : HT_ERROR;
+    if (code != HT_OK)
+        unlink(outFile);
+    else // the close left the summary of the old file, the new one has the same records
+        summarySave(fileName, &compact, indexTable.records[indexDesc]);
+    if (openSlot(fileName, indexDesc) != HT_OK)
+        return HT_ERROR;
+    indexTable.extentBlocks[indexDesc] = extentBlocks;
+    if (bufferRecords > 0 && HT_SetWriteBuffer(indexDesc, bufferRecords) != HT_OK)
+        return HT_ERROR;
+    return code;
+}
+
+HT_ErrorCode HT_GetSummary(int indexDesc, HT_Summary* summary)
+{
+    LOCK_BF();
+    int fileDesc;
+    if ((indexDesc < MAX_OPEN_FILES) && (indexDesc > -1) && (indexTable.fileDesc[indexDesc] != -1))
+        fileDesc = indexTable.fileDesc[indexDesc];
+    else
+        return HT_ERROR;
+
+    HashInfo info;
+    if (readInfo(fileDesc, &info) != HT_OK)
+        return HT_ERROR;
+    CALL_BF(BF_GetBlockCounter(fileDesc, &summary->blocks));
+    summary->depth = info.depth;
+    // the first block and the directory pages are not buckets
+    summary->buckets = summary->blocks - 1 - pagesOf(info.segments) - info.freeBlocks;
+    summary->records = indexTable.records[indexDesc];
+    if (info.mode == LINEAR) { // the file counts its records, the write buffer holds the rest
+        const WriteBuffer* buffer = writeBuffers[indexDesc];
+        summary->records = info.recordCount;
+        if (buffer != NULL) {
+            summary->records += buffer->count[buffer->active];
+            if (buffer->flushing)
+                summary->records += buffer->count[1 - buffer->active] - buffer->flushed;
+        }
+    }
+    summary->clean = indexTable.clean[indexDesc];
+    const Validation* validation = validations[indexDesc];
+    summary->unvalidated = validation != NULL && !validation->done ? summary->blocks - validation->next : 0;
+    summary->damaged = validation != NULL && validation->damaged;
+    return HT_OK;
+}
+
+HT_ErrorCode HT_Validate(int indexDesc)
+{
+    LOCK_BF();
+    if ((indexDesc >= MAX_OPEN_FILES) || (indexDesc < 0) || (indexTable.fileDesc[indexDesc] == -1))
+        return HT_ERROR;
+    return finishValidation(indexDesc);
+}
+
+HT_ErrorCode HashStatistics(char* fileName)
+{
+    LOCK_BF();
+    int indexDesc;
+    if (HT_OpenIndex(fileName, &indexDesc) != HT_OK)
+        return HT_ERROR;
+
+    HT_Statistics stats;
+    if (HT_GetStatistics(indexDesc, &stats) != HT_OK)
+        return HT_ERROR;
+    printf("File '%s' has %d Blocks\n", fileName, stats.blocks);
+    if (stats.blocks == 1) {
+        printf("No data yet in the file!\n");
+    } else if (stats.buckets != 0) {
+        // computing using records in buckets
+        double average = (double)stats.records / stats.buckets;
+
+        // printing the statistics
+        printf("Minimum Records: %d\n", stats.minRecords);
+        printf("Average Records: %f\n", average);
+        printf("Maximum Records: %d\n", stats.maxRecords);
+    }
+    if (stats.bloomBytes != 0)
+        printf("Bloom Filter: %d bytes for %d ids, %.3f%% false positives\n", stats.bloomBytes,
+            stats.bloomKeys, 100 * stats.bloomFalsePositive);
+
+    return HT_CloseFile(indexDesc);
+}
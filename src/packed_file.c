@@ -0,0 +1,450 @@
+#include "packed_file.h"
+#include "bf.h"
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define MAX_FIELD 20 // the longest string field of a Record
+#define FIELD_COUNT 3
+
+static PackedFile packedTable[MAX_OPEN_PACKED]; // open packed files, map NULL when free
+
+static const struct { size_t offset; int size; } fields[FIELD_COUNT] = {
+  { offsetof(Record, name), sizeof(((Record *)0)->name) },
+  { offsetof(Record, surname), sizeof(((Record *)0)->surname) },
+  { offsetof(Record, city), sizeof(((Record *)0)->city) }
+};
+
+typedef struct Pages{ // the bucket pages of an index collected by HT_Compress
+  Record *records;
+  int recordCount;
+  int recordCapacity;
+  int *counts; // records of every page
+  int pageCount;
+  int pageCapacity;
+  bool failed;
+} Pages;
+
+typedef struct Entry{ // a string seen while building the dictionary
+  unsigned char bytes[MAX_FIELD];
+  int length;
+  int count;
+  int code; // 0 while it is written as a literal
+} Entry;
+
+typedef struct Dictionary{
+  Entry *entries;
+  int entryCount;
+  int entryCapacity;
+  int *table; // open addressing over the entries, index in entries or -1
+  int bits;
+} Dictionary;
+
+static void addPage(const Record *records, int count, void *ctx)
+{
+  Pages *pages = ctx;
+  if (pages->failed)
+    return;
+  if (pages->recordCount + count > pages->recordCapacity) {
+    int capacity = pages->recordCapacity == 0 ? 1024 : pages->recordCapacity * 2;
+    Record *grown = realloc(pages->records, capacity * sizeof(Record));
+    if (grown == NULL) {
+      pages->failed = true;
+      return;
+    }
+    pages->records = grown;
+    pages->recordCapacity = capacity;
+  }
+  if (pages->pageCount == pages->pageCapacity) {
+    int capacity = pages->pageCapacity == 0 ? 256 : pages->pageCapacity * 2;
+    int *grown = realloc(pages->counts, capacity * sizeof(int));
+    if (grown == NULL) {
+      pages->failed = true;
+      return;
+    }
+    pages->counts = grown;
+    pages->pageCapacity = capacity;
+  }
+  memcpy(&pages->records[pages->recordCount], records, count * sizeof(Record));
+  pages->recordCount += count;
+  pages->counts[pages->pageCount++] = count;
+}
+
+// the bytes of a field up to its last one that is not 0, the padding after it is not stored
+static int trimmedLength(const unsigned char *field, int size)
+{
+  while (size > 0 && field[size - 1] == 0)
+    size--;
+  return size;
+}
+
+static unsigned stringHash(const unsigned char *bytes, int length)
+{
+  unsigned hash = 2166136261u; // FNV-1a
+  for (int i = 0; i < length; i++)
+    hash = (hash ^ bytes[i]) * 16777619u;
+  return hash;
+}
+
+// the entry of a string, added the first time it is seen, -1 without memory
+static int findEntry(Dictionary *dict, const unsigned char *bytes, int length)
+{
+  if (dict->table == NULL || dict->entryCount * 2 >= (1 << dict->bits)) { // at most half full
+    int bits = dict->bits == 0 ? 10 : dict->bits + 1;
+    int *table = malloc((1 << bits) * sizeof(int));
+    if (table == NULL)
+      return -1;
+    memset(table, -1, (1 << bits) * sizeof(int));
+    for (int e = 0; e < dict->entryCount; e++) {
+      unsigned h = stringHash(dict->entries[e].bytes, dict->entries[e].length) & ((1 << bits) - 1);
+      while (table[h] != -1)
+        h = (h + 1) & ((1 << bits) - 1);
+      table[h] = e;
+    }
+    free(dict->table);
+    dict->table = table;
+    dict->bits = bits;
+  }
+  unsigned mask = (1 << dict->bits) - 1;
+  unsigned h = stringHash(bytes, length) & mask;
+  for (; dict->table[h] != -1; h = (h + 1) & mask) {
+    Entry *entry = &dict->entries[dict->table[h]];
+    if (entry->length == length && memcmp(entry->bytes, bytes, length) == 0)
+      return dict->table[h];
+  }
+  if (dict->entryCount == dict->entryCapacity) {
+    int capacity = dict->entryCapacity == 0 ? 1024 : dict->entryCapacity * 2;
+    Entry *grown = realloc(dict->entries, capacity * sizeof(Entry));
+    if (grown == NULL)
+      return -1;
+    dict->entries = grown;
+    dict->entryCapacity = capacity;
+  }
+  Entry *entry = &dict->entries[dict->entryCount];
+  memcpy(entry->bytes, bytes, length);
+  entry->length = length;
+  entry->count = 0;
+  entry->code = 0;
+  dict->table[h] = dict->entryCount;
+  return dict->entryCount++;
+}
+
+static const Entry *sortedEntries; // qsort has no context argument
+
+static int compareCounts(const void *a, const void *b)
+{
+  int x = sortedEntries[*(const int *)a].count, y = sortedEntries[*(const int *)b].count;
+  return (x < y) - (x > y); // the most frequent first, they get the one byte codes
+}
+
+// count every string of every record, the ones seen more than once get a code by frequency.
+// order returns the entries that got a code, in the order of their codes
+static bool buildDictionary(Dictionary *dict, const Pages *pages, int **order, int *dictCount)
+{
+  for (int r = 0; r < pages->recordCount; r++) {
+    for (int f = 0; f < FIELD_COUNT; f++) {
+      const unsigned char *field = (const unsigned char *)&pages->records[r] + fields[f].offset;
+      int e = findEntry(dict, field, trimmedLength(field, fields[f].size));
+      if (e == -1)
+        return false;
+      dict->entries[e].count += 1;
+    }
+  }
+  *order = malloc((dict->entryCount + 1) * sizeof(int));
+  if (*order == NULL)
+    return false;
+  int n = 0;
+  for (int e = 0; e < dict->entryCount; e++) {
+    if (dict->entries[e].count > 1)
+      (*order)[n++] = e;
+  }
+  sortedEntries = dict->entries;
+  qsort(*order, n, sizeof(int), compareCounts);
+  *dictCount = n < PACKED_DICT_MAX ? n : PACKED_DICT_MAX;
+  for (int c = 0; c < *dictCount; c++)
+    dict->entries[(*order)[c]].code = c + 1;
+  return true;
+}
+
+static int putVarint(unsigned char *out, unsigned long long value)
+{
+  int n = 0;
+  while (value >= 0x80) {
+    out[n++] = (unsigned char)(value | 0x80);
+    value >>= 7;
+  }
+  out[n++] = (unsigned char)value;
+  return n;
+}
+
+// NULL if the value runs past end
+static const unsigned char *getVarint(const unsigned char *p, const unsigned char *end, unsigned long long *value)
+{
+  *value = 0;
+  for (int shift = 0; p < end && shift < 64; shift += 7) {
+    unsigned char byte = *p++;
+    *value |= (unsigned long long)(byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+      return p;
+  }
+  return NULL;
+}
+
+// a page is its record count, then for every record the difference of its id from the one before
+// (zigzag, so small negative ones stay short) and every string field as a dictionary code, or
+// code 0 with a length byte and the bytes of the field without its trailing zeros. -1 without memory
+static int encodePage(Dictionary *dict, const Record *records, int count, unsigned char *out)
+{
+  int n = putVarint(out, count);
+  long long previous = 0;
+  for (int r = 0; r < count; r++) {
+    long long delta = records[r].id - previous;
+    previous = records[r].id;
+    n += putVarint(out + n, ((unsigned long long)delta << 1) ^ (unsigned long long)(delta >> 63));
+    for (int f = 0; f < FIELD_COUNT; f++) {
+      const unsigned char *field = (const unsigned char *)&records[r] + fields[f].offset;
+      int length = trimmedLength(field, fields[f].size);
+      int e = findEntry(dict, field, length);
+      if (e == -1)
+        return -1;
+      int code = dict->entries[e].code;
+      n += putVarint(out + n, code);
+      if (code == 0) {
+        out[n++] = (unsigned char)length;
+        memcpy(out + n, field, length);
+        n += length;
+      }
+    }
+  }
+  return n;
+}
+
+static bool decodePage(const PackedFile *file, int page, Record *records, int *count)
+{
+  const PackedSlot *slot = &file->slots[page];
+  const unsigned char *p = file->data + slot->offset, *end = p + slot->length;
+  unsigned long long value;
+  if ((p = getVarint(p, end, &value)) == NULL || value > MAX_RECORDS)
+    return false;
+  *count = (int)value;
+  long long id = 0;
+  for (int r = 0; r < *count; r++) {
+    Record *record = &records[r];
+    memset(record, 0, sizeof(Record));
+    if ((p = getVarint(p, end, &value)) == NULL)
+      return false;
+    id += (long long)(value >> 1) ^ -(long long)(value & 1);
+    record->id = (int)id;
+    for (int f = 0; f < FIELD_COUNT; f++) {
+      unsigned char *field = (unsigned char *)record + fields[f].offset;
+      if ((p = getVarint(p, end, &value)) == NULL || value > (unsigned long long)file->header->dictCount)
+        return false;
+      if (value != 0) {
+        const PackedString *string = &file->dictionary[value - 1];
+        memcpy(field, string->bytes, string->length);
+        continue;
+      }
+      if (p == end || *p > fields[f].size || end - (p + 1) < *p)
+        return false;
+      memcpy(field, p + 1, *p);
+      p += 1 + *p;
+    }
+  }
+  return true;
+}
+
+static bool writeAll(FILE *file, const void *data, long count)
+{
+  return count == 0 || fwrite(data, count, 1, file) == 1;
+}
+
+HT_ErrorCode HT_Compress(int indexDesc, const char *outFile)
+{
+  Pages pages = { NULL, 0, 0, NULL, 0, 0, false };
+  Dictionary dict = { NULL, 0, 0, NULL, 0 };
+  int *order = NULL, dictCount = 0;
+  PackedSlot *slots = NULL;
+  unsigned char *data = NULL;
+  bool ok = HT_ScanPages(indexDesc, addPage, &pages) == HT_OK && !pages.failed &&
+            buildDictionary(&dict, &pages, &order, &dictCount);
+
+  // the pages are encoded into one buffer, there is always room for one more page
+  long size = 0, capacity = 0;
+  slots = ok ? calloc(pages.pageCount + 1, sizeof(PackedSlot)) : NULL; // zeroed padding, the map is written as it is
+  ok = ok && slots != NULL;
+  for (int page = 0, first = 0; ok && page < pages.pageCount; first += pages.counts[page++]) {
+    if (size + PACKED_PAGE_MAX > capacity) {
+      capacity = capacity == 0 ? 64 * PACKED_PAGE_MAX : capacity * 2;
+      unsigned char *grown = realloc(data, capacity);
+      if (grown == NULL) {
+        ok = false;
+        break;
+      }
+      data = grown;
+    }
+    slots[page].offset = size;
+    slots[page].length = encodePage(&dict, &pages.records[first], pages.counts[page], data + size);
+    ok = slots[page].length != -1;
+    size += slots[page].length;
+  }
+
+  PackedHeader header;
+  memset(&header, 0, sizeof(PackedHeader));
+  header.magic = PACKED_MAGIC;
+  header.pageCount = pages.pageCount;
+  header.recordCount = pages.recordCount;
+  header.dictCount = dictCount;
+  header.dictOffset = sizeof(PackedHeader);
+  header.mapOffset = header.dictOffset;
+  for (int c = 0; c < dictCount; c++)
+    header.mapOffset += 1 + dict.entries[order[c]].length;
+  long padding = (8 - header.mapOffset % 8) % 8; // the map is read in place as longs
+  header.mapOffset += padding;
+  header.dataOffset = header.mapOffset + (long)pages.pageCount * sizeof(PackedSlot);
+  header.rawBytes = (long)pages.pageCount * BF_BLOCK_SIZE;
+  header.packedBytes = size;
+
+  // written next to the target and renamed over it, a reader never sees half a file
+  char tmpName[512];
+  snprintf(tmpName, sizeof(tmpName), "%s.tmp", outFile);
+  FILE *file = ok ? fopen(tmpName, "wb") : NULL;
+  ok = file != NULL && writeAll(file, &header, sizeof(PackedHeader));
+  for (int c = 0; ok && c < dictCount; c++) {
+    const Entry *entry = &dict.entries[order[c]];
+    unsigned char length = entry->length;
+    ok = writeAll(file, &length, 1) && writeAll(file, entry->bytes, length);
+  }
+  static const char zeros[8];
+  ok = ok && writeAll(file, zeros, padding) && writeAll(file, slots, (long)pages.pageCount * sizeof(PackedSlot)) &&
+       writeAll(file, data, size);
+  ok = ok && fflush(file) == 0 && fsync(fileno(file)) == 0;
+  if (file != NULL)
+    ok = fclose(file) == 0 && ok;
+  ok = ok && rename(tmpName, outFile) == 0;
+  if (!ok)
+    unlink(tmpName);
+  free(data);
+  free(slots);
+  free(order);
+  free(dict.entries);
+  free(dict.table);
+  free(pages.records);
+  free(pages.counts);
+  return ok ? HT_OK : HT_ERROR;
+}
+
+HT_ErrorCode PK_OpenIndex(const char *fileName, int *packedDesc)
+{
+  int slot = -1;
+  for (int i = 0; i < MAX_OPEN_PACKED && slot == -1; i++) {
+    if (packedTable[i].map == NULL)
+      slot = i;
+  }
+  if (slot == -1)
+    return HT_ERROR;
+
+  int fd = open(fileName, O_RDONLY);
+  struct stat st;
+  if (fd == -1)
+    return HT_ERROR;
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(PackedHeader)) {
+    close(fd);
+    return HT_ERROR;
+  }
+  const unsigned char *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd); // the mapping keeps the file
+  if (map == MAP_FAILED)
+    return HT_ERROR;
+
+  const PackedHeader *header = (const PackedHeader *)map;
+  PackedString *dictionary = NULL;
+  bool ok = header->magic == PACKED_MAGIC && header->pageCount >= 0 && header->dictCount >= 0 &&
+            header->dictOffset <= header->mapOffset &&
+            header->mapOffset + (long)header->pageCount * (long)sizeof(PackedSlot) == header->dataOffset &&
+            header->dataOffset + header->packedBytes <= st.st_size;
+  if (ok) {
+    dictionary = malloc((header->dictCount + 1) * sizeof(PackedString));
+    ok = dictionary != NULL;
+  }
+  const unsigned char *p = map + (ok ? header->dictOffset : 0);
+  for (int c = 0; ok && c < header->dictCount; c++) {
+    ok = p < map + header->mapOffset && p + 1 + *p <= map + header->mapOffset;
+    if (ok) {
+      dictionary[c].length = *p;
+      dictionary[c].bytes = p + 1;
+      p += 1 + *p;
+    }
+  }
+  if (!ok) {
+    free(dictionary);
+    munmap((void *)map, st.st_size);
+    return HT_ERROR;
+  }
+  madvise((void *)map, st.st_size, MADV_SEQUENTIAL); // read by scans
+  PackedFile *file = &packedTable[slot];
+  file->map = map;
+  file->size = st.st_size;
+  file->header = header;
+  file->slots = (const PackedSlot *)(map + header->mapOffset);
+  file->data = map + header->dataOffset;
+  file->dictionary = dictionary;
+  *packedDesc = slot;
+  return HT_OK;
+}
+
+HT_ErrorCode PK_CloseFile(int packedDesc)
+{
+  if (packedDesc < 0 || packedDesc >= MAX_OPEN_PACKED || packedTable[packedDesc].map == NULL)
+    return HT_ERROR;
+  munmap((void *)packedTable[packedDesc].map, packedTable[packedDesc].size);
+  free(packedTable[packedDesc].dictionary);
+  memset(&packedTable[packedDesc], 0, sizeof(PackedFile));
+  return HT_OK;
+}
+
+HT_ErrorCode PK_ReadPage(int packedDesc, int page, Record *records, int *count)
+{
+  if (packedDesc < 0 || packedDesc >= MAX_OPEN_PACKED || packedTable[packedDesc].map == NULL)
+    return HT_ERROR;
+  const PackedFile *file = &packedTable[packedDesc];
+  if (page < 0 || page >= file->header->pageCount)
+    return HT_ERROR;
+  const PackedSlot *slot = &file->slots[page];
+  if (slot->offset < 0 || slot->length < 0 || slot->offset + slot->length > file->header->packedBytes)
+    return HT_ERROR;
+  return decodePage(file, page, records, count) ? HT_OK : HT_ERROR;
+}
+
+HT_ErrorCode PK_ScanPages(int packedDesc, HT_PageCallback callback, void *ctx)
+{
+  if (packedDesc < 0 || packedDesc >= MAX_OPEN_PACKED || packedTable[packedDesc].map == NULL || callback == NULL)
+    return HT_ERROR;
+  Record records[MAX_RECORDS]; // the frame every page is decompressed into
+  for (int page = 0; page < packedTable[packedDesc].header->pageCount; page++) {
+    int count;
+    if (PK_ReadPage(packedDesc, page, records, &count) != HT_OK)
+      return HT_ERROR;
+    if (count > 0)
+      callback(records, count, ctx);
+  }
+  return HT_OK;
+}
+
+HT_ErrorCode PackedStatistics(char *fileName)
+{
+  int packedDesc;
+  if (PK_OpenIndex(fileName, &packedDesc) != HT_OK)
+    return HT_ERROR;
+  const PackedHeader *header = packedTable[packedDesc].header;
+  printf("File '%s' has %d Pages and %d Records\n", fileName, header->pageCount, header->recordCount);
+  printf("Dictionary Strings: %d\n", header->dictCount);
+  printf("Raw Bytes: %ld\n", header->rawBytes);
+  printf("Packed Bytes: %ld (%.1f%%)\n", header->packedBytes,
+         header->rawBytes == 0 ? 0.0 : 100.0 * header->packedBytes / header->rawBytes);
+  return PK_CloseFile(packedDesc);
+}
@@ -0,0 +1,260 @@
+#include "query_file.h"
+#include <limits.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct Scan{ // state of a running query
+  const Query *query;
+  QueryResult *result;
+  Record batch[QUERY_BATCH]; // records waiting to be filtered
+  int count;
+  int rowCapacity;
+  int groupCapacity;
+  int *groupTable; // open addressing over the keys, index in result->groups or -1
+  int groupBits;
+  bool failed; // set by the page callback, it can not return an error to the scan
+} Scan;
+
+static const struct { size_t offset; int size; } fields[] = {
+  { offsetof(Record, id), sizeof(int) },
+  { offsetof(Record, name), sizeof(((Record *)0)->name) },
+  { offsetof(Record, surname), sizeof(((Record *)0)->surname) },
+  { offsetof(Record, city), sizeof(((Record *)0)->city) }
+};
+
+static bool isStringColumn(Column column)
+{
+  return column == COLUMN_NAME || column == COLUMN_SURNAME || column == COLUMN_CITY;
+}
+
+// copy a string field, it may fill its array without a terminating 0
+static void copyKey(const Record *record, Column column, char *key)
+{
+  const char *field = (const char *)record + fields[column].offset;
+  int length = strnlen(field, fields[column].size);
+  memcpy(key, field, length);
+  key[length] = '\0';
+}
+
+static bool matches(const Record *record, const Predicate *predicate)
+{
+  char field[MAX_KEY + 1];
+  copyKey(record, predicate->column, field);
+  switch (predicate->op) {
+    case PRED_EQUALS: return strcmp(field, predicate->value) == 0;
+    case PRED_PREFIX: return strncmp(field, predicate->value, strlen(predicate->value)) == 0;
+    case PRED_CONTAINS: return strstr(field, predicate->value) != NULL;
+  }
+  return false;
+}
+
+static unsigned keyHash(const char *key)
+{
+  unsigned hash = 2166136261u; // FNV-1a
+  for (; *key; key++)
+    hash = (hash ^ (unsigned char)*key) * 16777619u;
+  return hash;
+}
+
+static bool addGroup(Scan *scan, const char *key)
+{
+  QueryResult *result = scan->result;
+  if (result->groupCount == scan->groupCapacity) {
+    scan->groupCapacity = scan->groupCapacity == 0 ? 16 : scan->groupCapacity * 2;
+    QueryGroup *groups = realloc(result->groups, scan->groupCapacity * sizeof(QueryGroup));
+    if (groups == NULL)
+      return false;
+    result->groups = groups;
+  }
+  QueryGroup *group = &result->groups[result->groupCount++];
+  strcpy(group->key, key);
+  group->count = 0;
+  group->minId = INT_MAX;
+  group->maxId = INT_MIN;
+  return true;
+}
+
+// the group of a key, a new one the first time the key is seen
+static QueryGroup *findGroup(Scan *scan, const char *key)
+{
+  QueryResult *result = scan->result;
+  if (scan->groupTable == NULL || result->groupCount * 2 >= (1 << scan->groupBits)) { // at most half full
+    int bits = scan->groupBits == 0 ? 6 : scan->groupBits + 1;
+    int *table = malloc((1 << bits) * sizeof(int));
+    if (table == NULL)
+      return NULL;
+    memset(table, -1, (1 << bits) * sizeof(int));
+    for (int g = 0; g < result->groupCount; g++) {
+      unsigned h = keyHash(result->groups[g].key) & ((1 << bits) - 1);
+      while (table[h] != -1)
+        h = (h + 1) & ((1 << bits) - 1);
+      table[h] = g;
+    }
+    free(scan->groupTable);
+    scan->groupTable = table;
+    scan->groupBits = bits;
+  }
+  unsigned mask = (1 << scan->groupBits) - 1;
+  unsigned h = keyHash(key) & mask;
+  for (; scan->groupTable[h] != -1; h = (h + 1) & mask) {
+    if (strcmp(result->groups[scan->groupTable[h]].key, key) == 0)
+      return &result->groups[scan->groupTable[h]];
+  }
+  if (!addGroup(scan, key))
+    return NULL;
+  scan->groupTable[h] = result->groupCount - 1;
+  return &result->groups[result->groupCount - 1];
+}
+
+static void aggregate(QueryGroup *group, int id)
+{
+  group->count += 1;
+  if (id < group->minId)
+    group->minId = id;
+  if (id > group->maxId)
+    group->maxId = id;
+}
+
+// filter the records of the batch and hand the ones that pass to the projection or the groups
+static bool flushBatch(Scan *scan)
+{
+  const Query *query = scan->query;
+  QueryResult *result = scan->result;
+  int ids[QUERY_BATCH];
+  unsigned char pass[QUERY_BATCH];
+  int selected[QUERY_BATCH];
+  int count = scan->count;
+  result->scanned += count;
+  scan->count = 0;
+
+  // the id range on a column of ids, without branches so the loops vectorize
+  for (int i = 0; i < count; i++)
+    ids[i] = scan->batch[i].id;
+  for (int i = 0; i < count; i++)
+    pass[i] = (ids[i] >= query->minId) & (ids[i] <= query->maxId);
+  int n = 0;
+  for (int i = 0; i < count; i++) {
+    selected[n] = i;
+    n += pass[i];
+  }
+
+  // every predicate only looks at the records that passed the ones before it
+  for (int p = 0; p < query->predicateCount && n > 0; p++) {
+    int kept = 0;
+    for (int k = 0; k < n; k++) {
+      selected[kept] = selected[k];
+      kept += matches(&scan->batch[selected[k]], &query->predicates[p]);
+    }
+    n = kept;
+  }
+
+  if (query->groupBy != COLUMN_NONE) {
+    char key[MAX_KEY + 1];
+    for (int k = 0; k < n; k++) {
+      copyKey(&scan->batch[selected[k]], query->groupBy, key);
+      QueryGroup *group = findGroup(scan, key);
+      if (group == NULL)
+        return false;
+      aggregate(group, ids[selected[k]]);
+    }
+    return true;
+  }
+
+  if (result->rowCount + n > scan->rowCapacity) {
+    while (result->rowCount + n > scan->rowCapacity)
+      scan->rowCapacity = scan->rowCapacity == 0 ? QUERY_BATCH : scan->rowCapacity * 2;
+    Record *rows = realloc(result->rows, scan->rowCapacity * sizeof(Record));
+    if (rows == NULL)
+      return false;
+    result->rows = rows;
+  }
+  Record *rows = &result->rows[result->rowCount];
+  for (int k = 0; k < n; k++)
+    rows[k] = scan->batch[selected[k]];
+  // projection, the fields that are not kept are cleared
+  for (int c = COLUMN_NAME; c <= COLUMN_CITY; c++) {
+    if (query->projection & (1 << (c - COLUMN_NAME)))
+      continue;
+    for (int k = 0; k < n; k++)
+      memset((char *)&rows[k] + fields[c].offset, 0, fields[c].size);
+  }
+  for (int k = 0; k < n; k++)
+    aggregate(&result->groups[0], ids[selected[k]]);
+  result->rowCount += n;
+  return true;
+}
+
+static void addPage(const Record *records, int count, void *ctx)
+{
+  Scan *scan = ctx;
+  if (scan->failed)
+    return;
+  if (scan->count + count > QUERY_BATCH && !flushBatch(scan)) {
+    scan->failed = true;
+    return;
+  }
+  memcpy(&scan->batch[scan->count], records, count * sizeof(Record));
+  scan->count += count;
+}
+
+void QR_InitQuery(Query *query)
+{
+  memset(query, 0, sizeof(Query));
+  query->minId = INT_MIN;
+  query->maxId = INT_MAX;
+  query->predicateCount = 0;
+  query->projection = FIELD_ALL;
+  query->groupBy = COLUMN_NONE;
+}
+
+HT_ErrorCode QR_AddPredicate(Query *query, Column column, PredicateOp op, const char *value)
+{
+  if (query->predicateCount == MAX_PREDICATES || !isStringColumn(column) || strlen(value) > MAX_KEY)
+    return HT_ERROR;
+  Predicate *predicate = &query->predicates[query->predicateCount++];
+  predicate->column = column;
+  predicate->op = op;
+  strcpy(predicate->value, value);
+  return HT_OK;
+}
+
+HT_ErrorCode QR_Run(int indexDesc, const Query *query, QueryResult *result)
+{
+  memset(result, 0, sizeof(QueryResult));
+  if (query->groupBy != COLUMN_NONE && !isStringColumn(query->groupBy))
+    return HT_ERROR;
+
+  Scan *scan = malloc(sizeof(Scan));
+  if (scan == NULL)
+    return HT_ERROR;
+  scan->query = query;
+  scan->result = result;
+  scan->count = 0;
+  scan->rowCapacity = 0;
+  scan->groupCapacity = 0;
+  scan->groupTable = NULL;
+  scan->groupBits = 0;
+
+  bool ok = query->groupBy != COLUMN_NONE || addGroup(scan, ""); // one group for all the rows
+  scan->failed = !ok;
+  ok = ok && HT_ScanPages(indexDesc, addPage, scan) == HT_OK && !scan->failed && flushBatch(scan);
+  free(scan->groupTable);
+  free(scan);
+  if (!ok) {
+    QR_FreeResult(result);
+    return HT_ERROR;
+  }
+  for (int g = 0; g < result->groupCount; g++) {
+    if (result->groups[g].count == 0) // no ids to take the minimum and maximum of
+      result->groups[g].minId = result->groups[g].maxId = 0;
+  }
+  return HT_OK;
+}
+
+void QR_FreeResult(QueryResult *result)
+{
+  free(result->rows);
+  free(result->groups);
+  memset(result, 0, sizeof(QueryResult));
+}
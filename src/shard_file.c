@@ -0,0 +1,267 @@
+#include "shard_file.h"
+#include "bf.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CALL_BF(call)             \
+    {                             \
+        BF_ErrorCode code = call; \
+        if (code != BF_OK) {      \
+            BF_PrintError(code);  \
+            return HT_ERROR;      \
+        }                         \
+    }
+
+static ShardedIndex shardTable[MAX_OPEN_SHARDED]; // open sharded files, shardCount 0 when free
+
+// the name of the i-th shard of a file
+static void shardName(char* name, size_t size, const char* fileName, int shard)
+{
+    snprintf(name, size, "%s.%d", fileName, shard);
+}
+
+// top level hash, the high bits of a multiplicative hash scaled to the shards
+int shardFunction(int id, int shardCount)
+{
+    unsigned int mixed = (unsigned int)id * 2654435761u;
+    return (int)(((unsigned long long)mixed * (unsigned int)shardCount) >> 32);
+}
+
+HT_ErrorCode SH_CreateIndex(const char* fileName, int depth, int shardCount)
+{
+    if (shardCount < 1 || shardCount > MAX_SHARDS)
+        return HT_ERROR;
+
+    // the first block only knows how many shards there are
+    int fd;
+    CALL_BF(BF_CreateFile(fileName));
+    CALL_BF(BF_OpenFile(fileName, &fd));
+    BF_Block* infoBlock;
+    BF_Block_Init(&infoBlock);
+    BF_ErrorCode code = BF_AllocateBlock(fd, infoBlock);
+    if (code == BF_OK) {
+        ShardInfo info;
+        info.shardCount = shardCount;
+        info.depth = depth;
+        memcpy(BF_Block_GetData(infoBlock), &info, sizeof(ShardInfo));
+        BF_Block_SetDirty(infoBlock);
+        code = BF_UnpinBlock(infoBlock);
+    }
+    BF_Block_Destroy(&infoBlock);
+    if (code != BF_OK) {
+        BF_PrintError(code);
+        BF_CloseFile(fd);
+        return HT_ERROR;
+    }
+    CALL_BF(BF_CloseFile(fd));
+
+    char name[256];
+    for (int i = 0; i < shardCount; i++) {
+        shardName(name, sizeof(name), fileName, i);
+        if (HT_CreateIndex(name, depth) != HT_OK)
+            return HT_ERROR;
+    }
+    return HT_OK;
+}
+
+HT_ErrorCode SH_OpenIndex(const char* fileName, int* shardDesc)
+{
+    int slot = -1;
+    for (int i = 0; i < MAX_OPEN_SHARDED; i++) {
+        if (shardTable[i].shardCount == 0) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot == -1)
+        return HT_ERROR;
+
+    int fd;
+    CALL_BF(BF_OpenFile(fileName, &fd));
+    BF_Block* infoBlock;
+    BF_Block_Init(&infoBlock);
+    ShardInfo info;
+    BF_ErrorCode code = BF_GetBlock(fd, 0, infoBlock);
+    if (code == BF_OK) {
+        memcpy(&info, BF_Block_GetData(infoBlock), sizeof(ShardInfo));
+        code = BF_UnpinBlock(infoBlock);
+    }
+    BF_Block_Destroy(&infoBlock);
+    if (code != BF_OK) { // the file is closed on every path
+        BF_PrintError(code);
+        BF_CloseFile(fd);
+        return HT_ERROR;
+    }
+    CALL_BF(BF_CloseFile(fd));
+    if (info.shardCount < 1 || info.shardCount > MAX_SHARDS)
+        return HT_ERROR;
+
+    char name[256];
+    for (int i = 0; i < info.shardCount; i++) {
+        shardName(name, sizeof(name), fileName, i);
+        if (HT_OpenIndex(name, &shardTable[slot].indexDesc[i]) != HT_OK) {
+            while (i--) // close the shards that were opened
+                HT_CloseFile(shardTable[slot].indexDesc[i]);
+            return HT_ERROR;
+        }
+    }
+    shardTable[slot].shardCount = info.shardCount;
+    *shardDesc = slot;
+    return HT_OK;
+}
+
+// the sharded file at the given position, NULL if it is not open
+static ShardedIndex* getSharded(int shardDesc)
+{
+    if ((shardDesc < MAX_OPEN_SHARDED) && (shardDesc > -1) && (shardTable[shardDesc].shardCount != 0))
+        return &shardTable[shardDesc];
+    return NULL;
+}
+
+HT_ErrorCode SH_CloseFile(int shardDesc)
+{
+    ShardedIndex* sharded = getSharded(shardDesc);
+    if (sharded == NULL)
+        return HT_ERROR;
+
+    HT_ErrorCode result = HT_OK;
+    for (int i = 0; i < sharded->shardCount; i++) {
+        if (HT_CloseFile(sharded->indexDesc[i]) != HT_OK)
+            result = HT_ERROR;
+    }
+    sharded->shardCount = 0;
+    return result;
+}
+
+HT_ErrorCode SH_InsertEntry(int shardDesc, Record record)
+{
+    ShardedIndex* sharded = getSharded(shardDesc);
+    if (sharded == NULL)
+        return HT_ERROR;
+    int shard = shardFunction(record.id, sharded->shardCount);
+    return HT_InsertEntry(sharded->indexDesc[shard], record);
+}
+
+HT_ErrorCode SH_InsertEntries(int shardDesc, const Record* records, int count)
+{
+    ShardedIndex* sharded = getSharded(shardDesc);
+    if (sharded == NULL)
+        return HT_ERROR;
+
+    // counting sort of the records by shard, so each shard is loaded on its own
+    int start[MAX_SHARDS + 1] = { 0 };
+    for (int i = 0; i < count; i++)
+        start[shardFunction(records[i].id, sharded->shardCount) + 1]++;
+    for (int s = 0; s < sharded->shardCount; s++)
+        start[s + 1] += start[s];
+
+    int* order = malloc(count * sizeof(int));
+    if (order == NULL)
+        return HT_ERROR;
+    int fill[MAX_SHARDS];
+    memcpy(fill, start, sizeof(fill));
+    for (int i = 0; i < count; i++)
+        order[fill[shardFunction(records[i].id, sharded->shardCount)]++] = i;
+
+    for (int s = 0; s < sharded->shardCount; s++) {
+        for (int i = start[s]; i < start[s + 1]; i++) {
+            if (HT_InsertEntry(sharded->indexDesc[s], records[order[i]]) != HT_OK) {
+                free(order);
+                return HT_ERROR;
+            }
+        }
+    }
+    free(order);
+    return HT_OK;
+}
+
+HT_ErrorCode SH_PrintAllEntries(int shardDesc, int* id)
+{
+    ShardedIndex* sharded = getSharded(shardDesc);
+    if (sharded == NULL)
+        return HT_ERROR;
+
+    if (id != NULL) // only the shard of the id can have it
+        return HT_PrintAllEntries(sharded->indexDesc[shardFunction(*id, sharded->shardCount)], id);
+
+    for (int s = 0; s < sharded->shardCount; s++) {
+        if (HT_PrintAllEntries(sharded->indexDesc[s], NULL) != HT_OK)
+            return HT_ERROR;
+    }
+    return HT_OK;
+}
+
+HT_ErrorCode SH_GetStatistics(int shardDesc, HT_Statistics* stats)
+{
+    ShardedIndex* sharded = getSharded(shardDesc);
+    if (sharded == NULL)
+        return HT_ERROR;
+
+    stats->blocks = 0;
+    stats->buckets = 0;
+    stats->records = 0;
+    stats->minRecords = MAX_RECORDS + 1;
+    stats->maxRecords = 0;
+    stats->reservedBlocks = 0;
+    stats->freeBlocks = 0;
+    stats->bloomBytes = 0;
+    stats->bloomKeys = 0;
+    stats->bloomFalsePositive = 0;
+    stats->bloomNegatives = 0;
+    stats->bloomFalsePositives = 0;
+    for (int s = 0; s < sharded->shardCount; s++) {
+        HT_Statistics shardStats;
+        if (HT_GetStatistics(sharded->indexDesc[s], &shardStats) != HT_OK)
+            return HT_ERROR;
+        stats->blocks += shardStats.blocks;
+        stats->buckets += shardStats.buckets;
+        stats->records += shardStats.records;
+        stats->reservedBlocks += shardStats.reservedBlocks;
+        stats->freeBlocks += shardStats.freeBlocks;
+        stats->bloomBytes += shardStats.bloomBytes;
+        stats->bloomKeys += shardStats.bloomKeys;
+        stats->bloomNegatives += shardStats.bloomNegatives;
+        stats->bloomFalsePositives += shardStats.bloomFalsePositives;
+        if (shardStats.bloomFalsePositive > stats->bloomFalsePositive) // a lookup goes to one shard, the worst bounds it
+            stats->bloomFalsePositive = shardStats.bloomFalsePositive;
+        if (shardStats.buckets != 0 && shardStats.minRecords < stats->minRecords)
+            stats->minRecords = shardStats.minRecords;
+        if (shardStats.maxRecords > stats->maxRecords)
+            stats->maxRecords = shardStats.maxRecords;
+    }
+    if (stats->buckets == 0)
+        stats->minRecords = 0;
+    return HT_OK;
+}
+
+HT_ErrorCode ShardStatistics(char* fileName)
+{
+    int shardDesc;
+    if (SH_OpenIndex(fileName, &shardDesc) != HT_OK)
+        return HT_ERROR;
+    ShardedIndex* sharded = getSharded(shardDesc);
+
+    HT_Statistics stats;
+    for (int s = 0; s < sharded->shardCount; s++) {
+        if (HT_GetStatistics(sharded->indexDesc[s], &stats) != HT_OK) {
+            SH_CloseFile(shardDesc); // the slot and every shard are given back
+            return HT_ERROR;
+        }
+        printf("Shard %d: %d Blocks, %d Buckets, %d Records\n", s, stats.blocks,
+            stats.buckets, stats.records);
+    }
+
+    if (SH_GetStatistics(shardDesc, &stats) != HT_OK) {
+        SH_CloseFile(shardDesc);
+        return HT_ERROR;
+    }
+    printf("File '%s' has %d Shards and %d Blocks\n", fileName, sharded->shardCount, stats.blocks);
+    if (stats.buckets != 0) {
+        printf("Minimum Records: %d\n", stats.minRecords);
+        printf("Average Records: %f\n", (double)stats.records / stats.buckets);
+        printf("Maximum Records: %d\n", stats.maxRecords);
+    }
+
+    return SH_CloseFile(shardDesc);
+}
@@ -0,0 +1,440 @@
+#include "shared_pool.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static SharedHeader *pool; // the segment this process is attached to, NULL if none
+static long poolSize;
+static char poolName[MAX_FILE_NAME];
+static SharedFile sharedTable[MAX_OPEN_SHARED]; // open files, file 0 when free
+static int pinSlot = -1; // the SharedPinner of this process
+static pid_t pinSlotPid; // the process that took it, a child forked after that takes its own
+
+static int *pageTable(void)
+{
+  return (int *)(pool + 1);
+}
+
+static SharedFrame *frameAt(int frame)
+{
+  return (SharedFrame *)(pageTable() + pool->tableSize) + frame;
+}
+
+static long segmentSize(int frames, int tableSize)
+{
+  return sizeof(SharedHeader) + (long)tableSize * sizeof(int) + (long)frames * sizeof(SharedFrame);
+}
+
+static int chainOf(unsigned long long file, int block)
+{
+  unsigned long long h = file ^ ((unsigned long long)block * 0x9e3779b97f4a7c15ULL);
+  h ^= h >> 31;
+  h *= 0xbf58476d1ce4e5b9ULL;
+  h ^= h >> 29;
+  return (int)(h & (pool->tableSize - 1));
+}
+
+static void lockPool(void)
+{
+  if (pthread_mutex_lock(&pool->lock) == EOWNERDEAD) // its holder died, the table is as it left it
+    pthread_mutex_consistent(&pool->lock);
+}
+
+static HT_ErrorCode initSegment(SharedHeader *header, int frames, int tableSize)
+{
+  pthread_mutexattr_t attr;
+  if (pthread_mutexattr_init(&attr) != 0)
+    return HT_ERROR;
+  pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+  pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+  int failed = pthread_mutex_init(&header->lock, &attr);
+  pthread_mutexattr_destroy(&attr);
+  if (failed)
+    return HT_ERROR;
+  header->frames = frames;
+  header->tableSize = tableSize;
+  pool = header;
+  for (int i = 0; i < tableSize; i++)
+    pageTable()[i] = -1;
+  for (int i = 0; i < frames; i++)
+    frameAt(i)->next = -1; // the rest is zero, FRAME_FREE and no file
+  pool = NULL;
+  __atomic_store_n(&header->magic, SHARED_MAGIC, __ATOMIC_RELEASE); // the others may use it now
+  return HT_OK;
+}
+
+HT_ErrorCode SP_Attach(const char *name, int frames)
+{
+  if (pool != NULL || frames < 1 || strlen(name) >= MAX_FILE_NAME)
+    return HT_ERROR;
+  int tableSize = 2;
+  while (tableSize < frames * SHARED_TABLE_LOAD)
+    tableSize *= 2;
+  long size = segmentSize(frames, tableSize);
+
+  bool created = true;
+  int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (fd == -1 && errno == EEXIST) {
+    created = false;
+    fd = shm_open(name, O_RDWR, 0);
+  }
+  if (fd == -1)
+    return HT_ERROR;
+  if (created && ftruncate(fd, size) != 0) {
+    close(fd);
+    shm_unlink(name);
+    return HT_ERROR;
+  }
+  struct stat st;
+  for (int tries = 0; !created; tries++) { // wait for its creator to size it
+    if (fstat(fd, &st) != 0 || tries == 1000) {
+      close(fd);
+      return HT_ERROR;
+    }
+    if (st.st_size >= (long)sizeof(SharedHeader)) {
+      size = st.st_size;
+      break;
+    }
+    usleep(1000);
+  }
+  SharedHeader *header = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd); // the mapping keeps the segment
+  if (header == MAP_FAILED)
+    return HT_ERROR;
+
+  if (created && initSegment(header, frames, tableSize) != HT_OK) {
+    munmap(header, size);
+    shm_unlink(name);
+    return HT_ERROR;
+  }
+  for (int tries = 0; __atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != SHARED_MAGIC; tries++) {
+    if (tries == 1000) { // not a pool, or its creator died before it was ready
+      munmap(header, size);
+      return HT_ERROR;
+    }
+    usleep(1000);
+  }
+  if (segmentSize(header->frames, header->tableSize) != size) {
+    munmap(header, size);
+    return HT_ERROR;
+  }
+  pool = header;
+  poolSize = size;
+  strcpy(poolName, name);
+  return HT_OK;
+}
+
+HT_ErrorCode SP_Detach(bool remove)
+{
+  if (pool == NULL)
+    return HT_ERROR;
+  for (int i = 0; i < MAX_OPEN_SHARED; i++) {
+    if (sharedTable[i].file != 0)
+      SP_CloseFile(i);
+  }
+  if (pinSlot != -1 && pinSlotPid == getpid()) {
+    lockPool();
+    pool->pinners[pinSlot].pid = 0;
+    pthread_mutex_unlock(&pool->lock);
+  }
+  pinSlot = -1;
+  munmap(pool, poolSize);
+  pool = NULL;
+  if (remove && shm_unlink(poolName) != 0)
+    return HT_ERROR;
+  return HT_OK;
+}
+
+// take a frame for a new page with the clock, the caller holds the lock. A pinned frame is never
+// taken, and pins only grow under the lock, so one seen unpinned here stays so
+static int evictFrame(void)
+{
+  for (int step = 0; step < 2 * pool->frames; step++) {
+    int victim = pool->hand;
+    pool->hand = (pool->hand + 1) % pool->frames;
+    SharedFrame *frame = frameAt(victim);
+    if (__atomic_load_n(&frame->pins, __ATOMIC_ACQUIRE) != 0)
+      continue;
+    if (frame->referenced) {
+      frame->referenced = 0;
+      continue;
+    }
+    if (frame->file != 0) { // off the chain of its old page
+      int *link = &pageTable()[chainOf(frame->file, frame->block)];
+      while (*link != victim)
+        link = &frameAt(*link)->next;
+      *link = frame->next;
+      pool->evictions++;
+    }
+    return victim;
+  }
+  return -1;
+}
+
+// drop the pin of a pinner, once even if its process and another one that found it dead both try
+static void dropPin(SharedPinner *pinner)
+{
+  int frame = __atomic_exchange_n(&pinner->frame, -1, __ATOMIC_ACQ_REL);
+  if (frame != -1)
+    __atomic_sub_fetch(&frameAt(frame)->pins, 1, __ATOMIC_RELEASE);
+}
+
+static void unpinFrame(void)
+{
+  dropPin(&pool->pinners[pinSlot]);
+}
+
+// free the pinners of the processes that died, with their pins, the caller holds the lock
+static int reclaimPinners(void)
+{
+  int reclaimed = 0;
+  for (int i = 0; i < SHARED_PINNERS; i++) {
+    SharedPinner *pinner = &pool->pinners[i];
+    if (pinner->pid != 0 && kill(pinner->pid, 0) == -1 && errno == ESRCH) {
+      dropPin(pinner);
+      pinner->pid = 0;
+      reclaimed++;
+    }
+  }
+  return reclaimed;
+}
+
+// the pinner of this process, taken the first time it pins a page, the caller holds the lock
+static bool claimPinner(void)
+{
+  if (pinSlot != -1 && pinSlotPid == getpid())
+    return true;
+  for (int pass = 0; pass < 2; pass++) {
+    for (int i = 0; i < SHARED_PINNERS; i++) {
+      if (pool->pinners[i].pid == 0) {
+        pool->pinners[i].pid = getpid();
+        pool->pinners[i].frame = -1;
+        pinSlot = i;
+        pinSlotPid = getpid();
+        return true;
+      }
+    }
+    if (reclaimPinners() == 0)
+      break;
+  }
+  return false;
+}
+
+// read a page into a frame this process owns and publish it, on failure the frame goes back
+// to the free ones
+static bool loadFrame(const SharedFile *file, SharedFrame *frame, int victim)
+{
+  if (pread(file->fd, frame->data, BF_BLOCK_SIZE, (off_t)frame->block * BF_BLOCK_SIZE) == BF_BLOCK_SIZE) {
+    __atomic_store_n(&frame->state, FRAME_VALID, __ATOMIC_RELEASE);
+    return true;
+  }
+  lockPool();
+  int *link = &pageTable()[chainOf(frame->file, frame->block)];
+  while (*link != victim)
+    link = &frameAt(*link)->next;
+  *link = frame->next;
+  frame->file = 0;
+  __atomic_store_n(&frame->state, FRAME_FREE, __ATOMIC_RELEASE);
+  pthread_mutex_unlock(&pool->lock);
+  return false;
+}
+
+// the frame of a page, pinned and read in. Only one process reads a page from the disk, the
+// others that want it meanwhile wait for it, or take over if that process died
+static SharedFrame *pinPage(const SharedFile *file, int block)
+{
+  int chain = chainOf(file->file, block);
+  int found = -1, victim = -1;
+  for (int tries = 0;; tries++) {
+    lockPool();
+    if (!claimPinner()) { // as many processes pin pages as there are pinners
+      pthread_mutex_unlock(&pool->lock);
+      return NULL;
+    }
+    for (int i = pageTable()[chain]; i != -1 && found == -1; i = frameAt(i)->next) {
+      if (frameAt(i)->file == file->file && frameAt(i)->block == block)
+        found = i;
+    }
+    if (found != -1 || (victim = evictFrame()) != -1)
+      break;
+    // every frame is pinned, a process pins one page at a time and only to copy out of it, so
+    // pins that last are of processes that died, or of ones stuck with a page
+    if (reclaimPinners() > 0)
+      tries = 0;
+    pthread_mutex_unlock(&pool->lock);
+    if (tries == SHARED_PIN_TRIES)
+      return NULL;
+    if (tries < 100)
+      sched_yield();
+    else
+      usleep(1000);
+  }
+  if (found == -1) {
+    SharedFrame *frame = frameAt(victim);
+    frame->file = file->file;
+    frame->block = block;
+    frame->loader = getpid();
+    frame->referenced = 1;
+    __atomic_store_n(&frame->state, FRAME_LOADING, __ATOMIC_RELAXED);
+    __atomic_store_n(&frame->pins, 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&pool->pinners[pinSlot].frame, victim, __ATOMIC_RELEASE);
+    frame->next = pageTable()[chain];
+    pageTable()[chain] = victim;
+    pool->misses++;
+    pthread_mutex_unlock(&pool->lock);
+    if (loadFrame(file, frame, victim))
+      return frame;
+    unpinFrame();
+    return NULL;
+  }
+
+  SharedFrame *frame = frameAt(found);
+  __atomic_add_fetch(&frame->pins, 1, __ATOMIC_ACQ_REL);
+  __atomic_store_n(&pool->pinners[pinSlot].frame, found, __ATOMIC_RELEASE);
+  frame->referenced = 1;
+  pool->hits++;
+  bool loading = __atomic_load_n(&frame->state, __ATOMIC_ACQUIRE) == FRAME_LOADING;
+  if (loading)
+    pool->waits++;
+  pthread_mutex_unlock(&pool->lock);
+  while (loading) {
+    int loader = __atomic_load_n(&frame->loader, __ATOMIC_RELAXED);
+    if (kill(loader, 0) == -1 && errno == ESRCH &&
+        __atomic_compare_exchange_n(&frame->loader, &loader, getpid(), false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+      lockPool();
+      reclaimPinners(); // with the pin of the dead loader
+      pthread_mutex_unlock(&pool->lock);
+      if (loadFrame(file, frame, found))
+        return frame;
+      unpinFrame();
+      return NULL;
+    }
+    sched_yield();
+    loading = __atomic_load_n(&frame->state, __ATOMIC_ACQUIRE) == FRAME_LOADING;
+  }
+  if (__atomic_load_n(&frame->state, __ATOMIC_ACQUIRE) != FRAME_VALID) { // its loader could not read it
+    unpinFrame();
+    return NULL;
+  }
+  return frame;
+}
+
+HT_ErrorCode SP_OpenIndex(const char *fileName, int *sharedDesc)
+{
+  int slot = -1;
+  for (int i = 0; i < MAX_OPEN_SHARED && slot == -1; i++) {
+    if (sharedTable[i].file == 0)
+      slot = i;
+  }
+  if (pool == NULL || slot == -1)
+    return HT_ERROR;
+
+  SharedFile *file = &sharedTable[slot];
+  struct stat st;
+  file->fd = open(fileName, O_RDONLY);
+  if (file->fd == -1)
+    return HT_ERROR;
+  if (fstat(file->fd, &st) != 0 || st.st_size < BF_BLOCK_SIZE) {
+    close(file->fd);
+    return HT_ERROR;
+  }
+  unsigned long long identity = ((unsigned long long)st.st_dev << 32) ^ st.st_ino;
+  identity = identity * 0x9e3779b97f4a7c15ULL ^ ((unsigned long long)st.st_mtim.tv_sec * 1000000000ULL + st.st_mtim.tv_nsec);
+  file->file = identity == 0 ? 1 : identity;
+  file->blocks = st.st_size / BF_BLOCK_SIZE;
+
+  SharedFrame *frame = pinPage(file, 0);
+  if (frame == NULL) {
+    close(file->fd);
+    file->file = 0;
+    return HT_ERROR;
+  }
+  memcpy(&file->info, frame->data, sizeof(HashInfo));
+  unpinFrame();
+  if (file->info.magic != HASH_MAGIC || (file->info.mode != EXTENDIBLE && file->info.mode != LINEAR) || file->info.depth < 0 ||
+      file->info.depth > MAX_DEPTH || file->info.segments < 1 || file->info.segments > MAX_SEGMENTS) {
+    SP_CloseFile(slot);
+    return HT_ERROR;
+  }
+  *sharedDesc = slot;
+  return HT_OK;
+}
+
+HT_ErrorCode SP_CloseFile(int sharedDesc)
+{
+  if (sharedDesc < 0 || sharedDesc >= MAX_OPEN_SHARED || sharedTable[sharedDesc].file == 0)
+    return HT_ERROR;
+  close(sharedTable[sharedDesc].fd);
+  memset(&sharedTable[sharedDesc], 0, sizeof(SharedFile));
+  return HT_OK;
+}
+
+HT_ErrorCode SP_Lookup(int sharedDesc, int id, Record *records, int capacity, int *count)
+{
+  if (pool == NULL || sharedDesc < 0 || sharedDesc >= MAX_OPEN_SHARED || sharedTable[sharedDesc].file == 0)
+    return HT_ERROR;
+  const SharedFile *file = &sharedTable[sharedDesc];
+  int slot = slotOf(&file->info, id);
+  *count = 0;
+  SharedFrame *frame = pinPage(file, pageBlock(&file->info, slot));
+  if (frame == NULL)
+    return HT_ERROR;
+  int block = ((const HashTable *)frame->data)->buckets[slot % MAX_BUCKETS];
+  unpinFrame();
+
+  while (block != -1) { // the bucket and its overflow blocks
+    if (block <= 0 || block >= file->blocks || (frame = pinPage(file, block)) == NULL)
+      return HT_ERROR;
+    const Bucket *bucket = (const Bucket *)frame->data;
+    for (int i = 0; i < bucket->recordCount && i < MAX_RECORDS; i++) {
+      if (bucket->records[i].id == id) {
+        if (*count < capacity)
+          records[*count] = bucket->records[i];
+        *count += 1;
+      }
+    }
+    block = bucket->overflow;
+    unpinFrame();
+  }
+  return HT_OK;
+}
+
+HT_ErrorCode SP_PrintAllEntries(int sharedDesc, int *id)
+{
+  Record records[MAX_RECORDS];
+  int count;
+  if (id == NULL || SP_Lookup(sharedDesc, *id, records, MAX_RECORDS, &count) != HT_OK)
+    return HT_ERROR;
+  if (count == 0)
+    printf("ID doesn't exist\n");
+  for (int i = 0; i < count && i < MAX_RECORDS; i++)
+    printf("ID: %d, name: %s, surname: %s, city: %s\n", records[i].id, records[i].name, records[i].surname,
+           records[i].city);
+  return HT_OK;
+}
+
+HT_ErrorCode SharedStatistics()
+{
+  if (pool == NULL)
+    return HT_ERROR;
+  lockPool();
+  int used = 0, pinned = 0;
+  for (int i = 0; i < pool->frames; i++) {
+    used += frameAt(i)->file != 0;
+    pinned += __atomic_load_n(&frameAt(i)->pins, __ATOMIC_RELAXED) != 0;
+  }
+  long hits = pool->hits, misses = pool->misses;
+  printf("Shared pool '%s' has %d frames (%.1f KB), %d in use, %d pinned\n", poolName, pool->frames,
+         poolSize / 1024.0, used, pinned);
+  printf("Hits: %ld, misses: %ld, waits: %ld, evictions: %ld, hit rate: %.1f%%\n", hits, misses, pool->waits,
+         pool->evictions, hits + misses == 0 ? 0.0 : 100.0 * hits / (hits + misses));
+  pthread_mutex_unlock(&pool->lock);
+  return HT_OK;
+}